@@ -0,0 +1,153 @@
+// compares a fused kernel chain with the same work written by hand
+//
+// usage: kernel-bench [width height repeats]
+
+#include "../src/gl/kernel.hpp"
+
+#include <chrono>
+#include <memory>
+#include <cstdlib>
+#include <iostream>
+
+using clock_type = std::chrono::steady_clock;
+
+template<class F>
+double measure(int repeats, F&& f)
+{
+    double best = 1e300;
+
+    for (int r = 0; r < repeats; ++r)
+    {
+        auto start = clock_type::now();
+
+        f();
+
+        std::chrono::duration<double, std::milli> elapsed = clock_type::now() - start;
+
+        best = std::min(best, elapsed.count());
+    }
+
+    return best;
+}
+
+int main(int argc, char* argv[])
+{
+    int width = 1920;
+    int height = 1080;
+    int repeats = 50;
+
+    if (argc >= 4)
+    {
+        width = std::atoi(argv[1]);
+        height = std::atoi(argv[2]);
+        repeats = std::atoi(argv[3]);
+    }
+
+    std::unique_ptr<pixel[]> frame(new pixel[width * height]);
+    pixel* data = frame.get();
+
+    auto shade = [](int i, int j) { return pixel(i ^ j, i + j, i * j); };
+
+    const kernel::gamma gamma(2.2f);
+    const auto colormap = kernel::colormap::gradient(pixel(0, 0, 64), pixel(255, 220, 0));
+    const kernel::blend blend(pixel(255, 255, 255), 32);
+
+    volatile uint32_t sink = 0;
+
+    auto checksum = [&]() {
+        uint32_t sum = 0;
+
+        for (int k = 0; k < width * height; k += 97)
+        {
+            sum += data[k].r + data[k].g + data[k].b;
+        }
+
+        sink = sink + sum;
+
+        return sum;
+    };
+
+    double hand = measure(repeats, [&]() {
+        for (int i = 0; i < height; ++i)
+        {
+            int offset = i * width;
+
+            for (int j = 0; j < width; ++j)
+            {
+                data[offset + j] = blend(colormap(gamma(shade(i, j))));
+            }
+        }
+    });
+
+    auto reference = checksum();
+
+    double plain = measure(repeats, [&]() {
+        kernel::traverse(kernel::as_fused(kernel::pixels(shade)), data, width, height);
+    });
+
+    checksum();
+
+    const auto pixels = kernel::fuse(kernel::pixels(shade), gamma, colormap, blend);
+
+    double fused_pixels = measure(repeats, [&]() {
+        kernel::traverse(pixels, data, width, height);
+    });
+
+    bool valid = checksum() == reference;
+
+    const auto rows = kernel::fuse(kernel::rows([&shade](int i, pixel* row, int width) {
+        for (int j = 0; j < width; ++j)
+        {
+            row[j] = shade(i, j);
+        }
+    }), gamma, colormap, blend);
+
+    double fused_rows = measure(repeats, [&]() {
+        kernel::traverse(rows, data, width, height);
+    });
+
+    valid = valid && checksum() == reference;
+
+    const auto tiles = kernel::fuse(kernel::tiles([&shade](int i, int j, int rows, int cols, pixel* origin, int stride) {
+        for (int y = 0; y < rows; ++y)
+        {
+            for (int x = 0; x < cols; ++x)
+            {
+                origin[y * stride + x] = shade(i + y, j + x);
+            }
+        }
+    }), gamma, colormap, blend);
+
+    double fused_tiles = measure(repeats, [&]() {
+        kernel::traverse(tiles, data, width, height);
+    });
+
+    valid = valid && checksum() == reference;
+
+    // the same stages as separate passes over the frame
+    double separate = measure(repeats, [&]() {
+        kernel::traverse(kernel::as_fused(kernel::pixels(shade)), data, width, height);
+
+        for (int k = 0; k < width * height; ++k) data[k] = gamma(data[k]);
+        for (int k = 0; k < width * height; ++k) data[k] = colormap(data[k]);
+        for (int k = 0; k < width * height; ++k) data[k] = blend(data[k]);
+    });
+
+    valid = valid && checksum() == reference;
+
+    std::cout << width << "x" << height << ", best of " << repeats << " (ms)\n";
+    std::cout << "kernel only          " << plain << '\n';
+    std::cout << "hand-written chain   " << hand << '\n';
+    std::cout << "fused per pixel      " << fused_pixels << '\n';
+    std::cout << "fused per row        " << fused_rows << '\n';
+    std::cout << "fused per tile       " << fused_tiles << '\n';
+    std::cout << "separate passes      " << separate << '\n';
+
+    if (!valid)
+    {
+        std::cerr << "fused output differs from the hand-written chain\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,145 @@
+// time to first view of a pyramid file (see tools/pyramid-convert.cpp)
+//
+// usage: pyramid-bench <file> [view_width view_height]
+//
+// measures opening the mapping, showing the overview (top level) and then
+// the full resolution view at the image center, with the file dropped from
+// the page cache first where the system allows it
+
+#include "../src/gl/pyramid.hpp"
+#include "../src/gl/pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+using clock_type = std::chrono::steady_clock;
+
+namespace
+{
+    double since(clock_type::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+    }
+
+    void drop_cache(const char* path)
+    {
+#if defined(__linux__)
+        int fd = ::open(path, O_RDONLY);
+
+        if (fd >= 0)
+        {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            ::close(fd);
+        }
+#else
+        (void)path;
+#endif
+    }
+
+    std::string resident()
+    {
+#if defined(__linux__)
+        std::ifstream status("/proc/self/status");
+        std::string line;
+
+        while (std::getline(status, line))
+        {
+            if (!line.compare(0, 6, "VmRSS:"))
+            {
+                return line.substr(6);
+            }
+        }
+#endif
+        return " n/a";
+    }
+
+    // loads the tiles of a view the way the explorer does: the batch is
+    // prefetched as tile_cache::request() hands it to the prefetcher, then
+    // the tiles are copied on worker threads like the tile cache generator
+    size_t show(const pyramid_reader& reader, thread_pool& workers, uint32_t level, uint64_t x, uint64_t y, uint64_t width, uint64_t height)
+    {
+        const uint32_t size = reader.tile_size();
+        const auto& info = reader.level(level);
+
+        const uint64_t x0 = x / size;
+        const uint64_t y0 = y / size;
+        const uint64_t x1 = std::min<uint64_t>(info.columns - 1, (x + width - 1) / size);
+        const uint64_t y1 = std::min<uint64_t>(info.rows - 1, (y + height - 1) / size);
+
+        const int columns = static_cast<int>(x1 - x0 + 1);
+        const int count = columns * static_cast<int>(y1 - y0 + 1);
+
+        for (int k = 0; k < count; ++k)
+        {
+            reader.prefetch(reader.tile(level, x0 + k % columns, y0 + k / columns));
+        }
+
+        std::atomic<size_t> tiles{ 0 };
+
+        workers.parallel_for(count, [&](int k) {
+            std::vector<pixel> data(static_cast<size_t>(size) * size);
+
+            if (reader.copy(level, x0 + k % columns, y0 + k / columns, data.data()))
+            {
+                ++tiles;
+            }
+        });
+
+        return tiles;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: pyramid-bench <file> [view_width view_height]\n";
+        return 1;
+    }
+
+    const uint64_t view_width = argc >= 4 ? std::strtoull(argv[2], nullptr, 10) : 1920;
+    const uint64_t view_height = argc >= 4 ? std::strtoull(argv[3], nullptr, 10) : 1080;
+
+    drop_cache(argv[1]);
+
+    auto start = clock_type::now();
+
+    pyramid_reader reader;
+
+    if (!reader.open(argv[1]))
+    {
+        std::cerr << "Unable to open " << argv[1] << '\n';
+        return 1;
+    }
+
+    const double opened = since(start);
+
+    // copies on every core, like the tile cache workers
+    thread_pool workers;
+
+    const uint32_t top = reader.levels() - 1;
+
+    show(reader, workers, top, 0, 0, reader.level(top).width, reader.level(top).height);
+
+    const double overview = since(start);
+
+    const auto& base = reader.level(0);
+
+    const uint64_t x = base.width > view_width ? (base.width - view_width) / 2 : 0;
+    const uint64_t y = base.height > view_height ? (base.height - view_height) / 2 : 0;
+
+    size_t tiles = show(reader, workers, 0, x, y, view_width, view_height);
+
+    const double detail = since(start);
+
+    std::cout << base.width << "x" << base.height << ", " << reader.levels() << " levels, tile " << reader.tile_size() << '\n';
+    std::cout << "open            " << opened << " ms\n";
+    std::cout << "overview        " << overview << " ms\n";
+    std::cout << "full resolution " << detail << " ms (" << tiles << " tiles)\n";
+    std::cout << "resident       " << resident() << '\n';
+
+    return 0;
+}
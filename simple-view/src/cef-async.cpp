@@ -1,13 +1,17 @@
 #include "cef/client.hpp"
 #include "cef/render.hpp"
+#include "cef/browser.hpp"
 
 #include <string>
 #include <vector>
 #include <cassert>
+#include <cstdlib>
 #include <iostream>
 
 int main(int argc, char* argv[])
 {
+	StartupTrace::mark("main");
+
 	CefRefPtr<CefCommandLine> commandLine = CefCommandLine::CreateCommandLine();
 #if defined(_WIN32)
 	CefEnableHighDPISupport();
@@ -18,6 +22,16 @@ int main(int argc, char* argv[])
 	commandLine->InitFromArgv(argc, argv);
 #endif
 
+	auto options = StartupOptions::fromCommandLine(commandLine);
+	std::string appType = commandLine->GetSwitchValue("type");
+
+	if (!options.trace.empty())
+	{
+		StartupTrace::enable(options.trace, appType);
+	}
+
+	StartupTrace::mark("command line parsed");
+
 	void* windowsSandboxInfo = NULL;
 
 #if defined(CEF_USE_SANDBOX) && defined(_WIN32)
@@ -28,11 +42,22 @@ int main(int argc, char* argv[])
 #endif
 
 	CefRefPtr<CefApp> app = nullptr;
-	std::string appType = commandLine->GetSwitchValue("type");
 	if (appType == "renderer" || appType == "zygote")
 	{
 		auto __renderer = new RendererApp;
 
+		// onString is what the page uses first, the rest can wait for their first message
+		auto non_essential = [&__renderer, &options](const char* name, RendererApp::callback&& f) {
+			if (options.deferCallbacks)
+			{
+				__renderer->defer_callback(name, std::move(f));
+			}
+			else
+			{
+				__renderer->register_callback(name, std::move(f));
+			}
+		};
+
 		__renderer->register_callback(
 			"onString",
 			[](auto& package, auto args) {
@@ -43,11 +68,11 @@ int main(int argc, char* argv[])
 			}
 		);
 
-		__renderer->register_callback(
+		non_essential(
 			"onBinary",
 			[](auto& package, auto args) {
 				auto binary = args->GetBinary(0);
-				auto size = args->GetSize();
+				auto size = binary ? binary->GetSize() : 0;
 
 				if (size)
 				{
@@ -62,9 +87,15 @@ int main(int argc, char* argv[])
 			}
 		);
 
-		// use nullptr for other process types
+		StartupTrace::mark("callbacks registered");
+
 		app = __renderer;
 	}
+	else if (appType.empty())
+	{
+		app = new BrowserApp(options);
+	}
+	// use nullptr for other process types
 
 	int result = CefExecuteProcess(args, app, windowsSandboxInfo);
 	if (result >= 0)
@@ -73,13 +104,27 @@ int main(int argc, char* argv[])
 		return result;
 	}
 
+	StartupTrace::mark("execute process returned");
+
+	MinimalClient::cacheAssetPath = options.cacheAssetPath;
+	MinimalClient::startupTrace = options.trace;
+	MinimalClient::exitAfterLoad = options.exitAfterLoad;
+
 	CefSettings settings;
 	settings.remote_debugging_port = 1234;
 #if !defined(CEF_USE_SANDBOX)
 	settings.no_sandbox = true;
 #endif
 
-	CefInitialize(args, settings, nullptr, windowsSandboxInfo);
+	CefInitialize(args, settings, app, windowsSandboxInfo);
+
+	StartupTrace::mark("cef initialized");
+
+	// --measure-publish prints the publish cost per subscriber count
+	if (commandLine->HasSwitch("measure-publish"))
+	{
+		measure_publish(std::cout);
+	}
 
 	CefWindowInfo windowInfo;
 
@@ -91,18 +136,24 @@ int main(int argc, char* argv[])
 
 	auto client = MinimalClient::CreateBrowserSync(windowInfo, URL, browserSettings, nullptr, nullptr);
 
+	StartupTrace::mark("browser created sync");
+
+	// additional dashboard views sharing the client, --views=<count>
+	auto views = std::atoi(commandLine->GetSwitchValue("views").ToString().c_str());
+
+	for (int i = 1; i < views; ++i)
+	{
+		client->create_browser(windowInfo, URL, browserSettings);
+	}
+
 	client->register_callback<std::string>(
 		// name of method to bind
 		"onString",
 		
-		// function to process strings
+		// function to process strings, every subscribed view gets the reply
 		[&client](CefRefPtr<CefProcessMessage> msg, std::string &&text) -> void {
 
-			auto message = CefString(std::move(text));
-
-			msg->GetArgumentList()->SetString(0, message);
-
-			client->send(msg);
+			client->publish(msg->GetName().ToString(), payload::string(text));
 		}, 
 
 		// function to resolve argument lists
@@ -115,15 +166,10 @@ int main(int argc, char* argv[])
 		// name of method to bind
 		"onBinary",
 
-		// function to process buffer
+		// function to process buffer, every subscribed view gets the same frame
 		[&client](CefRefPtr<CefProcessMessage> msg, buffer<uint8_t> &&buffer) -> void {
 
-			auto binary = CefBinaryValue::Create(buffer.data.get(), buffer.size);
-
-			msg->GetArgumentList()->SetSize(buffer.size);
-			msg->GetArgumentList()->SetBinary(0, binary);
-
-			client->send(msg);
+			client->publish(msg->GetName().ToString(), payload::bytes(buffer.data.get(), buffer.size));
 		},
 
 		// function to resolve argument lists
@@ -193,5 +239,11 @@ int main(int argc, char* argv[])
 
 	CefShutdown();
 
+	if (!options.trace.empty())
+	{
+		// again with everything the renderers wrote after the first load
+		StartupTrace::combine(options.trace, options.trace + ".timeline");
+	}
+
 	return 0;
 }
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cef_cmake/disable_warnings.h>
+#include <include/cef_app.h>
+#include <cef_cmake/reenable_warnings.h>
+#include "../utils/startup.hpp"
+#include <string>
+#include <cstdlib>
+
+// startup switches of cef-async
+//
+//   --startup-trace=<file>   timestamps of every startup phase of all processes,
+//                            the combined timeline goes to <file>.timeline
+//   --prewarm-renderer       keeps a spare renderer process ready for navigation
+//   --defer-callbacks        renderer callbacks other than onString are
+//                            registered when their first message arrives
+//   --cache-asset-path       remembers the resolved html directory
+//   --exit-after-load=<ms>   closes every view that long after the first page
+//                            has loaded, for repeated runs (tools/startup-compare)
+struct StartupOptions
+{
+	std::string trace;
+
+	bool prewarmRenderer = false;
+	bool deferCallbacks = false;
+	bool cacheAssetPath = false;
+
+	// -1 keeps the views open
+	int exitAfterLoad = -1;
+
+	static StartupOptions fromCommandLine(CefRefPtr<CefCommandLine> commandLine)
+	{
+		StartupOptions options;
+
+		options.trace = commandLine->GetSwitchValue("startup-trace").ToString();
+		options.prewarmRenderer = commandLine->HasSwitch("prewarm-renderer");
+		options.deferCallbacks = commandLine->HasSwitch("defer-callbacks");
+		options.cacheAssetPath = commandLine->HasSwitch("cache-asset-path");
+
+		if (commandLine->HasSwitch("exit-after-load"))
+		{
+			options.exitAfterLoad = std::atoi(commandLine->GetSwitchValue("exit-after-load").ToString().c_str());
+		}
+
+		return options;
+	}
+};
+
+// browser process application, forwards the startup switches to the children
+struct BrowserApp : public CefApp, public CefBrowserProcessHandler
+{
+private:
+	StartupOptions __options;
+
+public:
+	BrowserApp(const StartupOptions& options) :
+		__options{ options }
+	{;}
+
+	CefRefPtr<CefBrowserProcessHandler> GetBrowserProcessHandler() override
+	{
+		return this;
+	}
+
+	void OnBeforeCommandLineProcessing(const CefString& process_type, CefRefPtr<CefCommandLine> command_line) override
+	{
+		if (process_type.empty() && __options.prewarmRenderer)
+		{
+			// a renderer is started ahead of the navigation that needs it. chromium
+			// starts the spare once the first navigation begins and keeps one ready
+			// for the next view, the trace shows it as a "launch renderer" mark
+			// more than there are views
+			const std::string feature = "SpareRendererForSitePerProcess";
+
+			std::string features = command_line->GetSwitchValue("enable-features").ToString();
+
+			if (features.find(feature) == std::string::npos)
+			{
+				features = features.empty() ? feature : features + "," + feature;
+			}
+
+			// the last value of a switch wins, the merged list keeps the user's features
+			command_line->AppendSwitchWithValue("enable-features", features);
+		}
+	}
+
+	void OnContextInitialized() override
+	{
+		StartupTrace::mark("context initialized");
+	}
+
+	void OnBeforeChildProcessLaunch(CefRefPtr<CefCommandLine> command_line) override
+	{
+		StartupTrace::mark(("launch " + command_line->GetSwitchValue("type").ToString()).c_str());
+
+		if (!__options.trace.empty())
+		{
+			command_line->AppendSwitchWithValue("startup-trace", __options.trace);
+		}
+
+		if (__options.deferCallbacks)
+		{
+			command_line->AppendSwitch("defer-callbacks");
+		}
+	}
+
+private:
+	IMPLEMENT_REFCOUNTING(BrowserApp);
+	DISALLOW_COPY_AND_ASSIGN(BrowserApp);
+};
@@ -6,9 +6,14 @@
 #include <include/wrapper/cef_resource_manager.h>
 #include <cef_cmake/reenable_warnings.h>
 #include "../utils/directory.hpp"
+#include "../utils/startup.hpp"
 #include "types.hpp"
+#include "registry.hpp"
 #include <jsbind.hpp>
 #include <map>
+#include <vector>
+#include <algorithm>
+#include <functional>
 
 #include <thread>
 #include <chrono>
@@ -35,9 +40,35 @@ void setupResourceManagerDirectoryProvider(CefRefPtr<CefResourceManager> resourc
 }
 
 
+// runs a closure on a cef thread
+struct closure_task : public CefTask
+{
+	std::function<void()> __fnc;
+
+	closure_task(std::function<void()> f) :
+		__fnc{ std::move(f) }
+	{;}
+
+	void Execute() override
+	{
+		__fnc();
+	}
+
+	IMPLEMENT_REFCOUNTING(closure_task);
+};
+
 // this is only needed so we have a way to break the message loop
-struct MinimalClient : public CefClient, public CefLifeSpanHandler, public CefRequestHandler, public CefResourceRequestHandler
+struct MinimalClient : public CefClient, public CefLifeSpanHandler, public CefLoadHandler, public CefRequestHandler, public CefResourceRequestHandler
 {
+	// resolve the html directory through DirUtil::getCachedAssetPath
+	static inline bool cacheAssetPath = false;
+
+	// trace file combined into a timeline once the first page has loaded
+	static inline std::string startupTrace;
+
+	// milliseconds after the first load until every view is closed, -1 never
+	static inline int exitAfterLoad = -1;
+
 	template<class ArgumentList>
 	struct callback_base
 	{
@@ -121,11 +152,18 @@ private:
 
 	CefRefPtr<CefBrowser> __browser;
 
+	// every open browser, the message loop ends with the last one
+	std::vector<CefRefPtr<CefBrowser>> __browsers;
+
+	subscriber_registry __registry;
+
 	MinimalClient() :
 		m_resourceManager(new CefResourceManager)
 	{
 		auto exePath = DirUtil::getCurrentExecutablePath();
-		auto assetPath = DirUtil::getAssetPath(exePath, "html"); // folder
+		auto assetPath = cacheAssetPath ? DirUtil::getCachedAssetPath(exePath, "html") : DirUtil::getAssetPath(exePath, "html"); // folder
+
+		StartupTrace::mark("asset path resolved");
 
 		setupResourceManagerDirectoryProvider(m_resourceManager, URI_ROOT, assetPath);
 	}
@@ -152,14 +190,104 @@ public:
 		__browser->GetMainFrame()->SendProcessMessage(PID_RENDERER, message);
 	}
 
+	// opens one more browser view served by this client
+	void create_browser(const CefWindowInfo& windowInfo, const CefString& url, const CefBrowserSettings& settings)
+	{
+		CefBrowserHost::CreateBrowser(windowInfo, this, url, settings, nullptr, nullptr);
+	}
+
+	// subscribes a frame from the browser side, pages may also
+	// call subscribe(topic) themselves
+	void subscribe(CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame, const std::string& topic)
+	{
+		__registry.subscribe(browser, frame, topic);
+	}
+
+	// sends the payload to every frame subscribed to the topic, may be called from any thread
+	void publish(const std::string& topic, std::shared_ptr<const payload> content)
+	{
+		if (!CefCurrentlyOn(TID_UI))
+		{
+			CefRefPtr<MinimalClient> self(this);
+
+			CefPostTask(TID_UI, new closure_task([self, topic, content]() { self->publish(topic, content); }));
+			return;
+		}
+
+		__registry.publish(topic, std::move(content));
+	}
+
+	subscriber_registry& registry()
+	{
+		return __registry;
+	}
+
 private:
 
 	CefRefPtr<CefLifeSpanHandler> GetLifeSpanHandler() override { return this; }
+	CefRefPtr<CefLoadHandler> GetLoadHandler()         override { return this; }
 	CefRefPtr<CefRequestHandler> GetRequestHandler()   override { return this; }
 
-	void OnBeforeClose(CefRefPtr<CefBrowser>) override
+	void OnAfterCreated(CefRefPtr<CefBrowser> browser) override
+	{
+		StartupTrace::mark("browser created");
+
+		__browsers.push_back(browser);
+	}
+
+	void OnLoadStart(CefRefPtr<CefBrowser>, CefRefPtr<CefFrame> frame, TransitionType /*transition_type*/) override
+	{
+		if (frame->IsMain())
+		{
+			StartupTrace::mark("load start");
+		}
+
+		// a reloaded page subscribes again, nothing it had in flight will be acknowledged
+		__registry.remove_frame(frame);
+	}
+
+	void OnLoadEnd(CefRefPtr<CefBrowser>, CefRefPtr<CefFrame> frame, int /*httpStatusCode*/) override
+	{
+		static bool first = true;
+
+		if (first && frame->IsMain())
+		{
+			first = false;
+
+			StartupTrace::mark("first load end");
+
+			if (!startupTrace.empty())
+			{
+				StartupTrace::combine(startupTrace, startupTrace + ".timeline");
+			}
+
+			if (exitAfterLoad >= 0)
+			{
+				CefRefPtr<MinimalClient> self(this);
+
+				CefPostDelayedTask(TID_UI, new closure_task([self]() {
+					// closing may remove a browser from the list right away
+					auto browsers = self->__browsers;
+
+					for (auto& browser : browsers)
+					{
+						browser->GetHost()->CloseBrowser(true);
+					}
+				}), exitAfterLoad);
+			}
+		}
+	}
+
+	void OnBeforeClose(CefRefPtr<CefBrowser> browser) override
 	{
-		CefQuitMessageLoop();
+		__registry.remove_browser(browser);
+
+		__browsers.erase(std::remove_if(__browsers.begin(), __browsers.end(), [&browser](auto& b) { return b->IsSame(browser); }), __browsers.end());
+
+		if (__browsers.empty())
+		{
+			CefQuitMessageLoop();
+		}
 	}
 
 	CefRefPtr<CefResourceRequestHandler> GetResourceRequestHandler(CefRefPtr<CefBrowser>, CefRefPtr<CefFrame>, CefRefPtr<CefRequest>, bool is_navigation, bool is_download, const CefString& request_initiator, bool& disable_default_handling) override
@@ -177,11 +305,29 @@ private:
 		return m_resourceManager->GetResourceHandler(browser, frame, request);
 	}
 
-	bool OnProcessMessageReceived(CefRefPtr<CefBrowser>, CefRefPtr<CefFrame>, CefProcessId /*source_process*/, CefRefPtr<CefProcessMessage> message) override
+	bool OnProcessMessageReceived(CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame, CefProcessId /*source_process*/, CefRefPtr<CefProcessMessage> message) override
 	{
 		auto name = message->GetName().ToString();
 		auto args = message->GetArgumentList();
 
+		if (name == "ack")
+		{
+			__registry.acknowledge(frame, args->GetInt(0));
+			return true;
+		}
+
+		if (name == "subscribe")
+		{
+			__registry.subscribe(browser, frame, args->GetString(0).ToString());
+			return true;
+		}
+
+		if (name == "unsubscribe")
+		{
+			__registry.unsubscribe(frame, args->GetString(0).ToString());
+			return true;
+		}
+
 		auto it = __cbstorage.find(name);
 		bool found = false;
 
@@ -0,0 +1,405 @@
+#pragma once
+
+#include <cef_cmake/disable_warnings.h>
+#include <include/cef_app.h>
+#include <include/cef_client.h>
+#include <cef_cmake/reenable_warnings.h>
+#include <map>
+#include <set>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ostream>
+#include <algorithm>
+
+// payload published to a topic, serialized once and shared by every
+// subscriber queue. a process message owns its arguments, so each send
+// still gets its own copy of the bytes, but only when it is dispatched.
+//
+// limitation: cef 92 has no shared memory process messages, a binary
+// payload is copied once per subscriber and publishing costs about
+// size * subscribers bytes of memcpy plus ipc (see measure_publish)
+struct payload
+{
+	CefString text;
+	CefRefPtr<CefBinaryValue> binary;
+
+	static std::shared_ptr<const payload> string(const std::string& value)
+	{
+		auto p = std::make_shared<payload>();
+
+		p->text = value;
+
+		return p;
+	}
+
+	static std::shared_ptr<const payload> bytes(const void* data, size_t size)
+	{
+		auto p = std::make_shared<payload>();
+
+		p->binary = CefBinaryValue::Create(data, size);
+
+		return p;
+	}
+
+	// arguments: 0 - content, 1 - sequence number the renderer acknowledges.
+	// the binary is copied here, once for every subscriber it goes to
+	CefRefPtr<CefProcessMessage> message(const std::string& topic, int sequence) const
+	{
+		auto msg = CefProcessMessage::Create(topic);
+		auto args = msg->GetArgumentList();
+
+		if (binary)
+		{
+			args->SetBinary(0, binary->Copy());
+		}
+		else
+		{
+			args->SetString(0, text);
+		}
+
+		args->SetInt(1, sequence);
+
+		return msg;
+	}
+};
+
+// frames subscribed to topics, each with its own bounded queue
+//
+// a frame gets at most `window` messages in flight, the next one is sent
+// when the renderer acknowledges one. when the queue of a slow frame is
+// full its oldest payload is dropped, other frames are not affected.
+// a frame that subscribes to a topic again, e.g. after a reload, starts
+// over with an empty queue and window. all methods run on the browser ui thread
+class subscriber_registry
+{
+public:
+	// delivers a message to a frame, false when the frame is gone
+	using sender = std::function<bool(CefRefPtr<CefProcessMessage>)>;
+
+	struct stats
+	{
+		uint64_t published = 0;
+		uint64_t sent = 0;
+		uint64_t dropped = 0;
+	};
+
+	// messages sent and not yet acknowledged per frame
+	size_t window = 2;
+
+	// payloads waiting per frame
+	size_t capacity = 8;
+
+private:
+	struct entry
+	{
+		std::string topic;
+		int sequence;
+
+		std::shared_ptr<const payload> content;
+	};
+
+	struct subscriber
+	{
+		sender send;
+		int browser = 0;
+
+		std::set<std::string> topics;
+		std::deque<entry> queue;
+
+		size_t in_flight = 0;
+
+		// acknowledgements up to this sequence belong to an earlier page
+		int since = 0;
+
+		uint64_t dropped = 0;
+	};
+
+	std::map<int64, subscriber> __subscribers;
+	std::map<std::string, std::vector<int64>> __topics;
+
+	int __sequence = 0;
+
+	stats __stats;
+
+public:
+	subscriber_registry() = default;
+
+	const stats& statistics() const
+	{
+		return __stats;
+	}
+
+	size_t subscribers(const std::string& topic) const
+	{
+		auto it = __topics.find(topic);
+
+		return it == __topics.end() ? 0 : it->second.size();
+	}
+
+	void subscribe(CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame, const std::string& topic)
+	{
+		subscribe(browser->GetIdentifier(), frame->GetIdentifier(), [frame](CefRefPtr<CefProcessMessage> message) {
+			if (!frame->IsValid())
+			{
+				return false;
+			}
+
+			frame->SendProcessMessage(PID_RENDERER, message);
+
+			return true;
+		}, topic);
+	}
+
+	void subscribe(int browser, int64 id, sender send, const std::string& topic)
+	{
+		auto& s = __subscribers[id];
+
+		s.send = std::move(send);
+		s.browser = browser;
+
+		if (s.topics.insert(topic).second)
+		{
+			__topics[topic].push_back(id);
+		}
+		else
+		{
+			// the page subscribed before and has been reloaded,
+			// what was in flight for the old page is never acknowledged
+			reset(s);
+		}
+	}
+
+	// the frame navigates, its subscriptions belong to the old document
+	void remove_frame(CefRefPtr<CefFrame> frame)
+	{
+		auto it = __subscribers.find(frame->GetIdentifier());
+
+		if (it != __subscribers.end())
+		{
+			remove(it);
+		}
+	}
+
+	void unsubscribe(CefRefPtr<CefFrame> frame, const std::string& topic)
+	{
+		auto it = __subscribers.find(frame->GetIdentifier());
+
+		if (it != __subscribers.end() && it->second.topics.erase(topic))
+		{
+			forget(it->first, topic);
+
+			if (it->second.topics.empty())
+			{
+				__subscribers.erase(it);
+			}
+		}
+	}
+
+	// drops every frame of a closing browser
+	void remove_browser(CefRefPtr<CefBrowser> browser)
+	{
+		const int id = browser->GetIdentifier();
+
+		for (auto it = __subscribers.begin(); it != __subscribers.end();)
+		{
+			if (it->second.browser == id)
+			{
+				it = remove(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	// queues the payload for every subscriber of the topic, the cost per
+	// subscriber is a shared pointer copy unless its window is open
+	void publish(const std::string& topic, std::shared_ptr<const payload> content)
+	{
+		++__stats.published;
+
+		auto it = __topics.find(topic);
+
+		if (it == __topics.end())
+		{
+			return;
+		}
+
+		const int sequence = ++__sequence;
+
+		std::vector<int64> closed;
+
+		for (auto id : it->second)
+		{
+			auto& s = __subscribers[id];
+
+			if (s.queue.size() >= capacity)
+			{
+				s.queue.pop_front();
+
+				++s.dropped;
+				++__stats.dropped;
+			}
+
+			s.queue.push_back(entry{ topic, sequence, content });
+
+			if (!pump(s))
+			{
+				closed.push_back(id);
+			}
+		}
+
+		for (auto id : closed)
+		{
+			remove(__subscribers.find(id));
+		}
+	}
+
+	// the renderer has delivered the message with the sequence number to its frame
+	void acknowledge(CefRefPtr<CefFrame> frame, int sequence)
+	{
+		acknowledge(frame->GetIdentifier(), sequence);
+	}
+
+	void acknowledge(int64 id, int sequence)
+	{
+		auto it = __subscribers.find(id);
+
+		if (it != __subscribers.end() && sequence > it->second.since)
+		{
+			if (it->second.in_flight)
+			{
+				--it->second.in_flight;
+			}
+
+			if (!pump(it->second))
+			{
+				remove(it);
+			}
+		}
+	}
+
+private:
+	using iterator = std::map<int64, subscriber>::iterator;
+
+	// sends what the window allows, false when the frame is gone
+	bool pump(subscriber& s)
+	{
+		while (s.in_flight < window && !s.queue.empty())
+		{
+			auto& next = s.queue.front();
+
+			if (!s.send(next.content->message(next.topic, next.sequence)))
+			{
+				return false;
+			}
+
+			s.queue.pop_front();
+
+			++s.in_flight;
+			++__stats.sent;
+		}
+
+		return true;
+	}
+
+	void reset(subscriber& s)
+	{
+		s.queue.clear();
+		s.in_flight = 0;
+		s.since = __sequence;
+	}
+
+	iterator remove(iterator it)
+	{
+		for (auto& topic : it->second.topics)
+		{
+			forget(it->first, topic);
+		}
+
+		return __subscribers.erase(it);
+	}
+
+	void forget(int64 id, const std::string& topic)
+	{
+		auto it = __topics.find(topic);
+
+		if (it == __topics.end())
+		{
+			return;
+		}
+
+		auto& ids = it->second;
+
+		ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+
+		if (ids.empty())
+		{
+			__topics.erase(it);
+		}
+	}
+};
+
+// browser side cost of publishing a binary payload against the number of
+// subscribers, printed as a table. the frames are stand-ins that drop the
+// message and acknowledge at once, so the numbers cover message creation,
+// the per subscriber copy and the queues but not the ipc itself.
+// needs an initialized cef, runs on the ui thread
+inline void measure_publish(std::ostream& out)
+{
+	using clock = std::chrono::steady_clock;
+
+	const size_t sizes[] = { 1 << 10, 64 << 10, 1 << 20, 8 << 20 };
+	const int counts[] = { 1, 2, 4, 8, 16, 32 };
+
+	out << "payload bytes  subscribers  us per publish  us per subscriber\n";
+
+	for (size_t size : sizes)
+	{
+		std::vector<uint8_t> data(size, 0x5a);
+
+		for (int count : counts)
+		{
+			subscriber_registry registry;
+
+			std::vector<std::pair<int64, int>> delivered;
+
+			for (int k = 0; k < count; ++k)
+			{
+				const int64 id = k + 1;
+
+				registry.subscribe(1, id, [&delivered, id](CefRefPtr<CefProcessMessage> message) {
+					delivered.emplace_back(id, message->GetArgumentList()->GetInt(1));
+					return true;
+				}, "measure");
+			}
+
+			// enough rounds for a few hundred milliseconds of the largest payloads
+			const int rounds = static_cast<int>(std::max<size_t>(4, (64u << 20) / (size * count)));
+
+			auto start = clock::now();
+
+			for (int r = 0; r < rounds; ++r)
+			{
+				registry.publish("measure", payload::bytes(data.data(), data.size()));
+
+				std::vector<std::pair<int64, int>> sent;
+				sent.swap(delivered);
+
+				for (auto& d : sent)
+				{
+					registry.acknowledge(d.first, d.second);
+				}
+			}
+
+			const double us = std::chrono::duration<double, std::micro>(clock::now() - start).count() / rounds;
+
+			out << size << "  " << count << "  " << us << "  " << us / count << '\n';
+		}
+	}
+}
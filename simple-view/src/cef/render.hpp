@@ -6,6 +6,7 @@
 #include <include/wrapper/cef_resource_manager.h>
 #include <cef_cmake/reenable_warnings.h>
 #include "../utils/directory.hpp"
+#include "../utils/startup.hpp"
 #include <jsbind.hpp>
 #include <iostream>
 #include <map>
@@ -51,10 +52,31 @@ void receiveData(jsbind::local v)
 	}
 }
 
+void sendTopic(const char* command, const std::string& topic)
+{
+	auto msg = CefProcessMessage::Create(command);
+
+	msg->GetArgumentList()->SetString(0, topic);
+
+	CefV8Context::GetCurrentContext()->GetFrame()->SendProcessMessage(PID_BROWSER, msg);
+}
+
+void subscribe(std::string topic)
+{
+	sendTopic("subscribe", topic);
+}
+
+void unsubscribe(std::string topic)
+{
+	sendTopic("unsubscribe", topic);
+}
+
 JSBIND_BINDINGS(App)
 {
 	jsbind::function("sendData", receiveData);
 	jsbind::function("setReceiveData", setReceiveData);
+	jsbind::function("subscribe", subscribe);
+	jsbind::function("unsubscribe", unsubscribe);
 }
 
 class ReleaseCallback : public CefV8ArrayBufferReleaseCallback
@@ -76,6 +98,11 @@ private:
 
 	std::multimap<std::string, callback> __cbstorage;
 
+	// callbacks registered when the first message for them arrives
+	std::multimap<std::string, callback> __deferred;
+
+	bool __first_message = true;
+
 public:
 	RendererApp() = default;
 
@@ -89,9 +116,18 @@ public:
 		__cbstorage.emplace(name, std::move(f));
 	}
 
+	void defer_callback(const char* name, callback&& f)
+	{
+		__deferred.emplace(name, std::move(f));
+	}
+
 	void OnContextCreated(CefRefPtr<CefBrowser> /*browser*/, CefRefPtr<CefFrame> /*frame*/, CefRefPtr<CefV8Context> /*context*/) override
 	{
+		StartupTrace::mark("context created");
+
 		jsbind::initialize();
+
+		StartupTrace::mark("jsbind initialized");
 	}
 
 	void OnContextReleased(CefRefPtr<CefBrowser> /*browser*/, CefRefPtr<CefFrame> /*frame*/, CefRefPtr<CefV8Context> /*context*/) override
@@ -104,12 +140,31 @@ public:
 		jsbind::deinitialize();
 	}
 
-	bool OnProcessMessageReceived(CefRefPtr<CefBrowser>, CefRefPtr<CefFrame>, CefProcessId /* source proccess */, CefRefPtr<CefProcessMessage> message) override
+	bool OnProcessMessageReceived(CefRefPtr<CefBrowser>, CefRefPtr<CefFrame> frame, CefProcessId /* source proccess */, CefRefPtr<CefProcessMessage> message) override
 	{
 		auto name = message->GetName();
 		auto args = message->GetArgumentList();
 		auto sent = false;
 
+		if (__first_message)
+		{
+			StartupTrace::mark("first message");
+
+			__first_message = false;
+		}
+
+		if (!__deferred.empty() && !__cbstorage.count(name))
+		{
+			auto range = __deferred.equal_range(name);
+
+			for (auto d = range.first; d != range.second; ++d)
+			{
+				__cbstorage.emplace(d->first, std::move(d->second));
+			}
+
+			__deferred.erase(range.first, range.second);
+		}
+
 		auto it = __cbstorage.find(name);
 
 		while (it != __cbstorage.end() && it->first == name.ToString())
@@ -136,6 +191,19 @@ public:
 			++it;
 		}
 
+		// published messages carry a sequence number, the browser
+		// sends the next one to this frame when it is acknowledged
+		if (args->GetSize() > 1 && args->GetType(1) == VTYPE_INT)
+		{
+			auto ack = CefProcessMessage::Create("ack");
+
+			ack->GetArgumentList()->SetInt(0, args->GetInt(1));
+
+			frame->SendProcessMessage(PID_BROWSER, ack);
+
+			sent = true;
+		}
+
 		return sent;
 	}
 private:
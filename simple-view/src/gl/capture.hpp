@@ -0,0 +1,611 @@
+#pragma once
+
+#include <new>
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <condition_variable>
+#include "pixel.hpp"
+
+#if defined(__linux__)
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+// asynchronous frame recorder
+//
+// the render loop hands frames over with submit(), which copies the frame
+// into one of a fixed number of preallocated slots and returns at once,
+// a writer thread drains the slots to disk. when every slot is in flight
+// the frame is dropped and counted instead of waiting for the disk
+//
+// formats:
+//   raw : single container, a header, frames with their own headers and an
+//         index of frame offsets at the end of the file (see raw_layout)
+//   ppm : one binary ppm per frame, <path>_<frame>.ppm
+class capture
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    enum class format
+    {
+        raw,
+        ppm
+    };
+
+    struct options
+    {
+        format type = format::raw;
+
+        // frames that may wait for the writer
+        size_t slots = 8;
+
+        // bytes collected before a write is issued
+        size_t chunk = 8 << 20;
+
+        // bypass the page cache where supported (linux O_DIRECT)
+        bool direct = false;
+    };
+
+    struct stats
+    {
+        uint64_t submitted = 0;
+        uint64_t written = 0;
+        uint64_t dropped = 0;
+
+        // frames that reached the writer but not the disk
+        uint64_t failed = 0;
+
+        uint64_t bytes = 0;
+
+        double write_ms = 0;
+    };
+
+    // layout of the raw container, all fields little endian
+    //
+    //   file_header
+    //   { frame_header, width * height * 4 bytes of rgba } * count
+    //   uint64_t offsets[count]
+    //   trailer
+    struct raw_layout
+    {
+        static constexpr char magic[8] = { 'S', 'V', 'C', 'A', 'P', 'T', '0', '1' };
+
+        struct file_header
+        {
+            char     magic[8];
+            uint32_t version;
+            uint32_t pixel_size;
+        };
+
+        struct frame_header
+        {
+            uint64_t index;
+            uint64_t timestamp_us;
+            uint32_t width;
+            uint32_t height;
+        };
+
+        struct trailer
+        {
+            uint64_t index_offset;
+            uint64_t count;
+            char     magic[8];
+        };
+    };
+
+private:
+
+    struct slot
+    {
+        std::vector<pixel> data;
+
+        int width = 0;
+        int height = 0;
+
+        uint64_t index = 0;
+        clock::time_point time;
+    };
+
+    // large sequential writer with an aligned staging buffer
+    class sink
+    {
+        static constexpr size_t alignment = 4096;
+
+        struct aligned_delete
+        {
+            void operator()(uint8_t* p) const
+            {
+                ::operator delete[](p, std::align_val_t(alignment));
+            }
+        };
+
+        std::unique_ptr<uint8_t[], aligned_delete> __buffer;
+
+        size_t __capacity = 0;
+        size_t __size = 0;
+
+        uint64_t __offset = 0;
+
+        // bytes the system accepted, nothing is written after the first error
+        uint64_t __flushed = 0;
+        bool __failed = false;
+
+#if defined(__linux__)
+        int __fd = -1;
+        bool __direct = false;
+#else
+        std::FILE* __file = nullptr;
+#endif
+
+    public:
+        sink() = default;
+
+        sink(const sink&) = delete;
+        sink& operator=(const sink&) = delete;
+
+        ~sink()
+        {
+            close();
+        }
+
+        bool open(const std::string& path, size_t chunk, bool direct)
+        {
+            __capacity = (chunk + alignment - 1) / alignment * alignment;
+            __buffer.reset(static_cast<uint8_t*>(::operator new[](__capacity, std::align_val_t(alignment))));
+            __size = 0;
+            __offset = 0;
+            __flushed = 0;
+            __failed = false;
+
+#if defined(__linux__)
+            int flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+            __direct = false;
+
+            if (direct)
+            {
+                __fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+                __direct = __fd >= 0;
+            }
+
+            if (__fd < 0)
+            {
+                __fd = ::open(path.c_str(), flags, 0644);
+            }
+
+            return __fd >= 0;
+#else
+            (void)direct;
+
+            __file = std::fopen(path.c_str(), "wb");
+
+            if (__file)
+            {
+                std::setvbuf(__file, nullptr, _IONBF, 0);
+            }
+
+            return __file != nullptr;
+#endif
+        }
+
+        bool is_open() const
+        {
+#if defined(__linux__)
+            return __fd >= 0;
+#else
+            return __file != nullptr;
+#endif
+        }
+
+        uint64_t offset() const
+        {
+            return __offset;
+        }
+
+        uint64_t flushed() const
+        {
+            return __flushed;
+        }
+
+        bool failed() const
+        {
+            return __failed;
+        }
+
+        void write(const void* data, size_t size)
+        {
+            auto* bytes = static_cast<const uint8_t*>(data);
+
+            __offset += size;
+
+            while (size)
+            {
+                size_t part = std::min(size, __capacity - __size);
+
+                std::memcpy(__buffer.get() + __size, bytes, part);
+
+                __size += part;
+                bytes += part;
+                size -= part;
+
+                if (__size == __capacity)
+                {
+                    flush();
+                }
+            }
+        }
+
+        void close()
+        {
+            if (!is_open())
+            {
+                return;
+            }
+
+#if defined(__linux__)
+            if (__direct && __size % alignment)
+            {
+                // the tail is not a whole block, finish it through the page cache
+                ::fcntl(__fd, F_SETFL, ::fcntl(__fd, F_GETFL) & ~O_DIRECT);
+                __direct = false;
+            }
+
+            flush();
+
+            ::close(__fd);
+            __fd = -1;
+#else
+            flush();
+
+            std::fclose(__file);
+            __file = nullptr;
+#endif
+        }
+
+    private:
+        void flush()
+        {
+            const uint8_t* data = __buffer.get();
+            size_t size = __failed ? 0 : __size;
+
+#if defined(__linux__)
+            while (size)
+            {
+                auto done = ::write(__fd, data, size);
+
+                if (done <= 0)
+                {
+                    __failed = true;
+                    break;
+                }
+
+                data += done;
+                size -= done;
+                __flushed += done;
+            }
+#else
+            if (size)
+            {
+                size_t done = std::fwrite(data, 1, size, __file);
+
+                __failed = done != size;
+                __flushed += done;
+            }
+#endif
+            __size = 0;
+        }
+    };
+
+    options __options;
+    std::string __path;
+
+    std::vector<std::unique_ptr<slot>> __slots;
+
+    // slots ready to be reused and slots waiting for the writer
+    std::vector<slot*> __free;
+    std::deque<slot*> __queue;
+
+    std::mutex __mutex;
+    std::condition_variable __ready;
+
+    std::thread __writer;
+    bool __stop = false;
+
+    clock::time_point __start;
+
+    uint64_t __next_index = 0;
+
+    std::atomic<uint64_t> __dropped{ 0 };
+
+    // owned by the writer thread until it is joined
+    stats __stats;
+
+    sink __sink;
+    std::vector<uint64_t> __offsets;
+    std::vector<uint8_t> __scratch;
+
+public:
+    capture() = default;
+
+    capture(const capture&) = delete;
+    capture& operator=(const capture&) = delete;
+
+    ~capture()
+    {
+        stop();
+    }
+
+    bool start(const std::string& path)
+    {
+        return start(path, options());
+    }
+
+    bool start(const std::string& path, const options& opts)
+    {
+        if (__writer.joinable())
+        {
+            return false;
+        }
+
+        __options = opts;
+        __path = path;
+
+        if (__options.type == format::raw)
+        {
+            if (!__sink.open(path, __options.chunk, __options.direct))
+            {
+                return false;
+            }
+
+            raw_layout::file_header header{};
+
+            std::memcpy(header.magic, raw_layout::magic, sizeof(header.magic));
+            header.version = 1;
+            header.pixel_size = sizeof(pixel);
+
+            __sink.write(&header, sizeof(header));
+            __offsets.clear();
+        }
+
+        __slots.clear();
+        __free.clear();
+        __queue.clear();
+
+        for (size_t i = 0; i < __options.slots; ++i)
+        {
+            __slots.emplace_back(new slot);
+            __free.push_back(__slots.back().get());
+        }
+
+        __stats = stats();
+        __dropped = 0;
+        __next_index = 0;
+        __stop = false;
+        __start = clock::now();
+
+        __writer = std::thread(&capture::writer, this);
+
+        return true;
+    }
+
+    // copies the frame into a free slot, never waits for the writer
+    bool submit(const pixel* data, int width, int height)
+    {
+        slot* s = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(__mutex);
+
+            if (!__writer.joinable() || __stop)
+            {
+                return false;
+            }
+
+            ++__stats.submitted;
+
+            if (__free.empty())
+            {
+                ++__dropped;
+                return false;
+            }
+
+            s = __free.back();
+            __free.pop_back();
+        }
+
+        s->data.assign(data, data + static_cast<size_t>(width) * height);
+        s->width = width;
+        s->height = height;
+        s->index = __next_index++;
+        s->time = clock::now();
+
+        {
+            std::lock_guard<std::mutex> lock(__mutex);
+
+            __queue.push_back(s);
+        }
+
+        __ready.notify_one();
+
+        return true;
+    }
+
+    bool recording() const
+    {
+        return __writer.joinable();
+    }
+
+    // drains the queued frames, closes the output and returns the totals
+    stats stop()
+    {
+        if (__writer.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(__mutex);
+
+                __stop = true;
+            }
+
+            __ready.notify_one();
+            __writer.join();
+
+            if (__options.type == format::raw)
+            {
+                finish_raw();
+            }
+        }
+
+        __stats.dropped = __dropped;
+
+        return __stats;
+    }
+
+    stats statistics()
+    {
+        std::lock_guard<std::mutex> lock(__mutex);
+
+        stats copy = __stats;
+
+        copy.dropped = __dropped;
+
+        return copy;
+    }
+
+private:
+
+    void writer()
+    {
+        while (true)
+        {
+            slot* s = nullptr;
+
+            {
+                std::unique_lock<std::mutex> lock(__mutex);
+
+                __ready.wait(lock, [this]() { return __stop || !__queue.empty(); });
+
+                if (__queue.empty())
+                {
+                    break;
+                }
+
+                s = __queue.front();
+                __queue.pop_front();
+            }
+
+            auto start = clock::now();
+
+            // zero when the frame could not be written
+            uint64_t bytes = __options.type == format::raw ? write_raw(*s) : write_ppm(*s);
+
+            std::chrono::duration<double, std::milli> elapsed = clock::now() - start;
+
+            {
+                std::lock_guard<std::mutex> lock(__mutex);
+
+                ++(bytes ? __stats.written : __stats.failed);
+                __stats.bytes += bytes;
+                __stats.write_ms += elapsed.count();
+
+                __free.push_back(s);
+            }
+        }
+    }
+
+    uint64_t write_raw(const slot& s)
+    {
+        raw_layout::frame_header header{};
+
+        header.index = s.index;
+        header.timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(s.time - __start).count();
+        header.width = s.width;
+        header.height = s.height;
+
+        __offsets.push_back(__sink.offset());
+
+        const size_t size = s.data.size() * sizeof(pixel);
+
+        __sink.write(&header, sizeof(header));
+        __sink.write(s.data.data(), size);
+
+        return __sink.failed() ? 0 : sizeof(header) + size;
+    }
+
+    void finish_raw()
+    {
+        raw_layout::trailer trailer{};
+
+        trailer.index_offset = __sink.offset();
+        trailer.count = __offsets.size();
+        std::memcpy(trailer.magic, raw_layout::magic, sizeof(trailer.magic));
+
+        __sink.write(__offsets.data(), __offsets.size() * sizeof(uint64_t));
+        __sink.write(&trailer, sizeof(trailer));
+        __sink.close();
+
+        // frames are buffered, an error may surface after they were counted,
+        // and without its trailer the container cannot be indexed at all
+        if (__sink.failed())
+        {
+            __stats.failed += __stats.written;
+            __stats.written = 0;
+            __stats.bytes = 0;
+        }
+    }
+
+    uint64_t write_ppm(const slot& s)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "_%06llu.ppm", static_cast<unsigned long long>(s.index));
+
+        char header[64];
+        int header_size = std::snprintf(header, sizeof(header), "P6\n%d %d\n255\n", s.width, s.height);
+
+        // ppm goes top to bottom, the frame rows go bottom to top
+        __scratch.resize(header_size + static_cast<size_t>(s.width) * s.height * 3);
+
+        uint8_t* out = __scratch.data();
+
+        std::memcpy(out, header, header_size);
+        out += header_size;
+
+        for (int i = s.height - 1; i >= 0; --i)
+        {
+            const pixel* row = s.data.data() + static_cast<size_t>(i) * s.width;
+
+            for (int j = 0; j < s.width; ++j)
+            {
+                *out++ = row[j].r;
+                *out++ = row[j].g;
+                *out++ = row[j].b;
+            }
+        }
+
+        std::FILE* file = std::fopen((__path + name).c_str(), "wb");
+
+        if (!file)
+        {
+            return 0;
+        }
+
+        size_t done = std::fwrite(__scratch.data(), 1, __scratch.size(), file);
+
+        if (std::fclose(file) != 0 || done != __scratch.size())
+        {
+            return 0;
+        }
+
+        return __scratch.size();
+    }
+};
@@ -0,0 +1,294 @@
+#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include "pixel.hpp"
+#include "pool.hpp"
+#include "image_format.hpp"
+
+// decoded image in the explorer pixel layout, bottom row first
+struct image
+{
+    int width = 0;
+    int height = 0;
+
+    std::unique_ptr<pixel[]> pixels;
+
+    explicit operator bool() const
+    {
+        return pixels != nullptr;
+    }
+};
+
+// native bmp, ppm/pgm and tga decoder
+//
+// the header is parsed once, then uncompressed images are decoded in bands
+// of rows on a thread pool straight into the destination buffer. rle tga
+// cannot be split without scanning it first and is decoded in one band
+class decoder
+{
+public:
+    struct stats
+    {
+        uint64_t files = 0;
+        uint64_t bytes = 0;
+        uint64_t pixels = 0;
+
+        double read_ms = 0;
+        double decode_ms = 0;
+
+        double megabytes_per_second() const
+        {
+            return read_ms + decode_ms > 0 ? bytes / 1e3 / (read_ms + decode_ms) : 0;
+        }
+
+        double megapixels_per_second() const
+        {
+            return read_ms + decode_ms > 0 ? pixels / 1e3 / (read_ms + decode_ms) : 0;
+        }
+    };
+
+    // rows per band handed to one worker
+    int band_rows = 64;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    using format = image_format;
+    using layout = image_layout;
+
+    thread_pool& __pool;
+
+    // files may be decoded from several tasks at once
+    mutable std::mutex __mutex;
+
+    stats __stats;
+
+public:
+    explicit decoder(thread_pool& pool) :
+        __pool{ pool }
+    {;}
+
+    thread_pool& pool()
+    {
+        return __pool;
+    }
+
+    stats statistics() const
+    {
+        std::lock_guard<std::mutex> lock(__mutex);
+
+        return __stats;
+    }
+
+    // reads and decodes a file, the result is empty when the format is unknown
+    image load(const std::string& path)
+    {
+        auto start = clock::now();
+
+        std::vector<uint8_t> bytes;
+
+        if (!read_file(path, bytes))
+        {
+            return image();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(__mutex);
+
+            __stats.read_ms += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        }
+
+        return decode(bytes.data(), bytes.size());
+    }
+
+    // decodes encoded bytes into a new buffer
+    image decode(const uint8_t* data, size_t size)
+    {
+        image result;
+
+        layout l = layout::probe(data, size);
+
+        if (l.type == format::none)
+        {
+            return result;
+        }
+
+        result.width = l.width;
+        result.height = l.height;
+        result.pixels.reset(new pixel[static_cast<size_t>(l.width) * l.height]);
+
+        if (!decode(l, data, size, result.pixels.get()))
+        {
+            result.pixels.reset();
+        }
+
+        return result;
+    }
+
+    // decodes encoded bytes into a caller provided staging buffer of
+    // width * height pixels, e.g. a mapped pixel unpack buffer
+    bool decode_into(const uint8_t* data, size_t size, pixel* out, int width, int height)
+    {
+        layout l = layout::probe(data, size);
+
+        return l.type != format::none && l.width == width && l.height == height && decode(l, data, size, out);
+    }
+
+    // image size from the start of a file, the rest is not read
+    static bool peek(const std::string& path, int& width, int& height)
+    {
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+
+        if (!file)
+        {
+            return false;
+        }
+
+        std::fseek(file, 0, SEEK_END);
+        long size = std::ftell(file);
+        std::fseek(file, 0, SEEK_SET);
+
+        uint8_t header[layout::header_bytes];
+
+        const size_t read = size > 0 ? std::fread(header, 1, sizeof(header), file) : 0;
+
+        std::fclose(file);
+
+        layout l = layout::probe(header, read, static_cast<size_t>(std::max(size, 0L)));
+
+        width = l.width;
+        height = l.height;
+
+        return l.type != format::none;
+    }
+
+    static bool read_file(const std::string& path, std::vector<uint8_t>& bytes)
+    {
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+
+        if (!file)
+        {
+            return false;
+        }
+
+        std::fseek(file, 0, SEEK_END);
+        long size = std::ftell(file);
+        std::fseek(file, 0, SEEK_SET);
+
+        bool ok = size > 0;
+
+        if (ok)
+        {
+            bytes.resize(static_cast<size_t>(size));
+
+            ok = std::fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        }
+
+        std::fclose(file);
+
+        return ok;
+    }
+
+private:
+
+    bool decode(const layout& l, const uint8_t* data, size_t size, pixel* out)
+    {
+        auto start = clock::now();
+
+        bool ok = true;
+
+        if (l.rle)
+        {
+            ok = decode_rle(l, data + size, out);
+        }
+        else
+        {
+            const int bands = (l.height + band_rows - 1) / band_rows;
+
+            __pool.parallel_for(bands, [this, &l, out](int band) {
+                const int first = band * band_rows;
+                const int last = std::min(l.height, first + band_rows);
+
+                for (int i = first; i < last; ++i)
+                {
+                    const int stored = l.top_down ? l.height - 1 - i : i;
+
+                    layout::convert(l, l.data + stored * l.stride, out + static_cast<size_t>(i) * l.width, l.width);
+                }
+            });
+        }
+
+        std::lock_guard<std::mutex> lock(__mutex);
+
+        __stats.decode_ms += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        __stats.files += 1;
+        __stats.bytes += size;
+        __stats.pixels += static_cast<uint64_t>(l.width) * l.height;
+
+        return ok;
+    }
+
+    static bool decode_rle(const layout& l, const uint8_t* end, pixel* out)
+    {
+        const uint8_t* src = l.data;
+        const size_t total = static_cast<size_t>(l.width) * l.height;
+
+        size_t k = 0;
+
+        auto place = [&l, out](size_t index, const uint8_t* value) {
+            const size_t i = index / l.width;
+            const size_t j = index % l.width;
+            const size_t row = l.top_down ? l.height - 1 - i : i;
+
+            layout::convert(l, value, out + row * l.width + j, 1);
+        };
+
+        while (k < total)
+        {
+            if (src >= end)
+            {
+                return false;
+            }
+
+            const uint8_t head = *src++;
+            const size_t count = std::min<size_t>((head & 0x7f) + 1, total - k);
+
+            if (head & 0x80)
+            {
+                if (src + l.channels > end)
+                {
+                    return false;
+                }
+
+                for (size_t n = 0; n < count; ++n)
+                {
+                    place(k++, src);
+                }
+
+                src += l.channels;
+            }
+            else
+            {
+                if (src + count * l.channels > end)
+                {
+                    return false;
+                }
+
+                for (size_t n = 0; n < count; ++n, src += l.channels)
+                {
+                    place(k++, src);
+                }
+            }
+        }
+
+        return true;
+    }
+};
@@ -0,0 +1,311 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include "pixel.hpp"
+
+enum class image_format
+{
+    none,
+    bmp,
+    pnm,
+    tga
+};
+
+// where the rows of an uncompressed bmp, ppm/pgm or tga image are and how
+// to convert them, parsed from the start of the file. shared by the decoder
+// and the tools that stream the rows from disk instead of loading the file
+struct image_layout
+{
+    image_format type = image_format::none;
+
+    int width = 0;
+    int height = 0;
+
+    // bytes per source pixel
+    int channels = 0;
+
+    const uint8_t* data = nullptr;
+    size_t stride = 0;
+
+    bool top_down = false;
+    bool bgr = false;
+    bool rle = false;
+
+    // the fourth byte of a bgr pixel is alpha, otherwise it is padding
+    bool alpha = false;
+
+    // 8 bit bmp palette, bgra entries
+    const uint8_t* palette = nullptr;
+    int palette_size = 0;
+
+    // pnm sample range
+    int max = 255;
+
+    // bytes to read from the start of a file, enough for every header and bmp palette
+    static constexpr size_t header_bytes = 4096;
+
+    // size bytes of the file are at data, total is the whole file. only
+    // the header has to be present, the pixel data is checked against total
+    static image_layout probe(const uint8_t* data, size_t size)
+    {
+        return probe(data, size, size);
+    }
+
+    static image_layout probe(const uint8_t* data, size_t size, size_t total)
+    {
+        if (size >= 54 && data[0] == 'B' && data[1] == 'M')
+        {
+            return probe_bmp(data, size, total);
+        }
+
+        if (size >= 3 && data[0] == 'P' && (data[1] == '5' || data[1] == '6'))
+        {
+            return probe_pnm(data, size, total);
+        }
+
+        // tga has no signature, check the header fields instead
+        return probe_tga(data, size, total);
+    }
+
+    static void convert(const image_layout& l, const uint8_t* src, pixel* dst, int count)
+    {
+        if (l.palette)
+        {
+            for (int j = 0; j < count; ++j)
+            {
+                const uint8_t* entry = l.palette + 4 * std::min<int>(src[j], l.palette_size - 1);
+
+                dst[j] = pixel(entry[2], entry[1], entry[0]);
+            }
+        }
+        else if (l.channels == 1)
+        {
+            for (int j = 0; j < count; ++j)
+            {
+                const uint8_t v = scale(l, src[j]);
+
+                dst[j] = pixel(v, v, v);
+            }
+        }
+        else if (l.bgr)
+        {
+            for (int j = 0; j < count; ++j, src += l.channels)
+            {
+                dst[j] = pixel(src[2], src[1], src[0], l.alpha ? src[3] : 255);
+            }
+        }
+        else
+        {
+            for (int j = 0; j < count; ++j, src += l.channels)
+            {
+                dst[j] = pixel(scale(l, src[0]), scale(l, src[1]), scale(l, src[2]));
+            }
+        }
+    }
+
+    static uint8_t scale(const image_layout& l, uint8_t v)
+    {
+        return l.max == 255 ? v : static_cast<uint8_t>(std::min(255, v * 255 / l.max));
+    }
+
+private:
+
+    template<class T>
+    static T le(const uint8_t* p)
+    {
+        T value = 0;
+
+        for (size_t k = 0; k < sizeof(T); ++k)
+        {
+            value |= static_cast<T>(p[k]) << (8 * k);
+        }
+
+        return value;
+    }
+
+    static image_layout probe_bmp(const uint8_t* data, size_t size, size_t total)
+    {
+        image_layout l;
+
+        const uint32_t offset = le<uint32_t>(data + 10);
+        const uint32_t header = le<uint32_t>(data + 14);
+        const int32_t width = le<int32_t>(data + 18);
+        const int32_t height = le<int32_t>(data + 22);
+        const uint16_t bits = le<uint16_t>(data + 28);
+        const uint32_t compression = le<uint32_t>(data + 30);
+        const uint32_t colors = le<uint32_t>(data + 46);
+
+        if (width <= 0 || !height || height == INT32_MIN || (bits != 8 && bits != 24 && bits != 32) || (compression != 0 && compression != 3))
+        {
+            return l;
+        }
+
+        bool alpha = false;
+
+        // BI_BITFIELDS, the masks follow a 40 byte header or are part of a
+        // larger one. only the byte aligned bgr(a) order of 32 bit pixels is
+        // supported, BI_RGB never has alpha
+        if (compression == 3)
+        {
+            if (bits != 32 || size < 66)
+            {
+                return l;
+            }
+
+            const uint32_t red = le<uint32_t>(data + 54);
+            const uint32_t green = le<uint32_t>(data + 58);
+            const uint32_t blue = le<uint32_t>(data + 62);
+            const uint32_t alpha_mask = header >= 56 && size >= 70 ? le<uint32_t>(data + 66) : 0;
+
+            if (red != 0x00ff0000 || green != 0x0000ff00 || blue != 0x000000ff || (alpha_mask && alpha_mask != 0xff000000))
+            {
+                return l;
+            }
+
+            alpha = alpha_mask != 0;
+        }
+
+        l.width = width;
+        l.height = height < 0 ? -height : height;
+        l.channels = bits / 8;
+        l.top_down = height < 0;
+        l.bgr = true;
+        l.alpha = alpha;
+        l.stride = (static_cast<size_t>(width) * l.channels + 3) / 4 * 4;
+        l.data = data + offset;
+
+        if (bits == 8)
+        {
+            l.palette = data + 14 + header;
+            l.palette_size = colors ? static_cast<int>(std::min<uint32_t>(colors, 256)) : 256;
+
+            if (14 + header + 4 * static_cast<size_t>(l.palette_size) > size)
+            {
+                return image_layout();
+            }
+        }
+
+        if (offset + l.stride * l.height > total)
+        {
+            return image_layout();
+        }
+
+        l.type = image_format::bmp;
+
+        return l;
+    }
+
+    static image_layout probe_pnm(const uint8_t* data, size_t size, size_t total)
+    {
+        image_layout l;
+
+        size_t k = 2;
+
+        auto token = [data, size, &k]() {
+            while (k < size && (data[k] == '#' || data[k] == ' ' || data[k] == '\t' || data[k] == '\r' || data[k] == '\n'))
+            {
+                if (data[k] == '#')
+                {
+                    while (k < size && data[k] != '\n')
+                    {
+                        ++k;
+                    }
+                }
+                else
+                {
+                    ++k;
+                }
+            }
+
+            long value = -1;
+
+            while (k < size && data[k] >= '0' && data[k] <= '9' && value < (1 << 24))
+            {
+                value = (value < 0 ? 0 : value * 10) + (data[k++] - '0');
+            }
+
+            return value;
+        };
+
+        const long width = token();
+        const long height = token();
+        const long max = token();
+
+        // exactly one whitespace separates the header from the samples
+        ++k;
+
+        if (width <= 0 || height <= 0 || max <= 0 || max > 255 || k > size)
+        {
+            return l;
+        }
+
+        l.width = static_cast<int>(width);
+        l.height = static_cast<int>(height);
+        l.channels = data[1] == '6' ? 3 : 1;
+        l.top_down = true;
+        l.max = static_cast<int>(max);
+        l.stride = static_cast<size_t>(width) * l.channels;
+        l.data = data + k;
+
+        if (k + l.stride * l.height > total)
+        {
+            return image_layout();
+        }
+
+        l.type = image_format::pnm;
+
+        return l;
+    }
+
+    static image_layout probe_tga(const uint8_t* data, size_t size, size_t total)
+    {
+        image_layout l;
+
+        if (size < 18)
+        {
+            return l;
+        }
+
+        const uint8_t id_length = data[0];
+        const uint8_t colormap = data[1];
+        const uint8_t type = data[2];
+        const int width = le<uint16_t>(data + 12);
+        const int height = le<uint16_t>(data + 14);
+        const uint8_t bits = data[16];
+        const uint8_t descriptor = data[17];
+
+        const bool gray = type == 3 || type == 11;
+        const bool color = type == 2 || type == 10;
+
+        if (colormap != 0 || (!gray && !color) || !width || !height)
+        {
+            return l;
+        }
+
+        if ((gray && bits != 8) || (color && bits != 24 && bits != 32))
+        {
+            return l;
+        }
+
+        l.width = width;
+        l.height = height;
+        l.channels = bits / 8;
+        l.top_down = (descriptor & 0x20) != 0;
+        l.bgr = color;
+        l.alpha = l.channels == 4;
+        l.rle = type >= 9;
+        l.stride = static_cast<size_t>(width) * l.channels;
+        l.data = data + 18 + id_length;
+
+        if (18u + id_length > total || (!l.rle && 18u + id_length + l.stride * height > total))
+        {
+            return image_layout();
+        }
+
+        l.type = image_format::tga;
+
+        return l;
+    }
+};
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <tuple>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include "pixel.hpp"
+
+// pixel kernels for explorer
+//
+// a kernel is a functor wrapped into one of the traversal kinds below, the
+// traversal is a template over the functor type so the call is inlined into
+// the loop instead of going through a pointer for every pixel
+//
+//   pixels(f) : pixel f(int i, int j)
+//   rows(f)   : void  f(int i, pixel* row, int width)
+//   tiles(f)  : void  f(int i, int j, int rows, int cols, pixel* origin, int stride)
+//
+// post-process stages (pixel s(pixel)) are attached with fuse() and applied
+// while the produced pixel, row or tile is still hot, so the whole chain is
+// one pass over the frame memory
+namespace kernel
+{
+    template<class F>
+    struct per_pixel
+    {
+        F f;
+    };
+
+    template<class F>
+    struct per_row
+    {
+        F f;
+    };
+
+    template<class F>
+    struct per_tile
+    {
+        F f;
+        int size;
+    };
+
+    template<class F>
+    per_pixel<F> pixels(F f)
+    {
+        return { std::move(f) };
+    }
+
+    template<class F>
+    per_row<F> rows(F f)
+    {
+        return { std::move(f) };
+    }
+
+    template<class F>
+    per_tile<F> tiles(F f, int size = 64)
+    {
+        return { std::move(f), size };
+    }
+
+    template<class K, class... stages>
+    struct fused
+    {
+        K kernel;
+        std::tuple<stages...> post;
+    };
+
+    template<class K, class... stages>
+    fused<K, stages...> fuse(K k, stages... s)
+    {
+        return { std::move(k), std::make_tuple(std::move(s)...) };
+    }
+
+    template<class K, class... stages, class... more>
+    fused<K, stages..., more...> fuse(fused<K, stages...> k, more... s)
+    {
+        return { std::move(k.kernel), std::tuple_cat(std::move(k.post), std::make_tuple(std::move(s)...)) };
+    }
+
+    template<class K>
+    fused<K> as_fused(const K& k)
+    {
+        return { k, {} };
+    }
+
+    template<class K, class... stages>
+    const fused<K, stages...>& as_fused(const fused<K, stages...>& k)
+    {
+        return k;
+    }
+
+    template<class... stages>
+    inline pixel post_process(const std::tuple<stages...>& post, pixel p)
+    {
+        std::apply([&p](const auto&... s) { ((p = s(p)), ...); }, post);
+
+        return p;
+    }
+
+    template<class... stages>
+    inline void post_process(const std::tuple<stages...>& post, pixel* data, int count)
+    {
+        if constexpr (sizeof...(stages) > 0)
+        {
+            for (int k = 0; k < count; ++k)
+            {
+                data[k] = post_process(post, data[k]);
+            }
+        }
+    }
+
+    template<class K>
+    struct is_per_pixel : std::false_type {};
+
+    template<class F, class... stages>
+    struct is_per_pixel<fused<per_pixel<F>, stages...>> : std::true_type {};
+
+    template<class F, class... stages>
+    void traverse(const fused<per_pixel<F>, stages...>& k, pixel* data, int width, int height)
+    {
+        for (int i = 0; i < height; ++i)
+        {
+            int offset = i * width;
+
+            for (int j = 0; j < width; ++j)
+            {
+                data[offset + j] = post_process(k.post, k.kernel.f(i, j));
+            }
+        }
+    }
+
+    template<class F, class... stages>
+    void traverse(const fused<per_row<F>, stages...>& k, pixel* data, int width, int height)
+    {
+        for (int i = 0; i < height; ++i)
+        {
+            pixel* row = data + i * width;
+
+            k.kernel.f(i, row, width);
+
+            post_process(k.post, row, width);
+        }
+    }
+
+    template<class F, class... stages>
+    void traverse(const fused<per_tile<F>, stages...>& k, pixel* data, int width, int height)
+    {
+        const int size = k.kernel.size;
+
+        for (int i = 0; i < height; i += size)
+        {
+            const int rows = std::min(size, height - i);
+
+            for (int j = 0; j < width; j += size)
+            {
+                const int cols = std::min(size, width - j);
+
+                pixel* origin = data + i * width + j;
+
+                k.kernel.f(i, j, rows, cols, origin, width);
+
+                for (int y = 0; y < rows; ++y)
+                {
+                    post_process(k.post, origin + y * width, cols);
+                }
+            }
+        }
+    }
+
+    // single sample of a per-pixel kernel, used by progressive refinement
+    template<class F, class... stages>
+    pixel sample(const fused<per_pixel<F>, stages...>& k, int i, int j)
+    {
+        return post_process(k.post, k.kernel.f(i, j));
+    }
+
+    // post-process stages
+
+    struct gamma
+    {
+        std::array<uint8_t, 256> lut;
+
+        explicit gamma(float value)
+        {
+            for (int v = 0; v < 256; ++v)
+            {
+                lut[v] = static_cast<uint8_t>(std::lround(255.0 * std::pow(v / 255.0, 1.0 / value)));
+            }
+        }
+
+        pixel operator()(pixel p) const
+        {
+            return pixel(lut[p.r], lut[p.g], lut[p.b], p.a);
+        }
+    };
+
+    // maps the luminance of a pixel through a 256 entry palette
+    struct colormap
+    {
+        std::array<pixel, 256> lut;
+
+        explicit colormap(const std::array<pixel, 256>& palette) :
+            lut{ palette }
+        {;}
+
+        static colormap gradient(pixel from, pixel to)
+        {
+            std::array<pixel, 256> palette;
+
+            for (int v = 0; v < 256; ++v)
+            {
+                auto mix = [v](uint8_t x, uint8_t y) { return static_cast<uint8_t>((x * (255 - v) + y * v + 127) / 255); };
+
+                palette[v] = pixel(mix(from.r, to.r), mix(from.g, to.g), mix(from.b, to.b), mix(from.a, to.a));
+            }
+
+            return colormap(palette);
+        }
+
+        pixel operator()(pixel p) const
+        {
+            const int luminance = (p.r * 77 + p.g * 150 + p.b * 29) >> 8;
+
+            pixel out = lut[luminance];
+
+            out.a = p.a;
+
+            return out;
+        }
+    };
+
+    // mixes a constant color over the pixel
+    struct blend
+    {
+        pixel color;
+        int alpha;
+
+        blend(pixel color, uint8_t alpha) :
+            color{ color }, alpha{ alpha }
+        {;}
+
+        pixel operator()(pixel p) const
+        {
+            auto mix = [this](int x, int y) { return static_cast<uint8_t>((x * (255 - alpha) + y * alpha + 127) / 255); };
+
+            return pixel(mix(p.r, color.r), mix(p.g, color.g), mix(p.b, color.b), p.a);
+        }
+    };
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+struct pixel
+{
+    uint8_t r{ 0 };
+    uint8_t g{ 0 };
+    uint8_t b{ 0 };
+
+    uint8_t a{ 255 };
+
+    pixel() = default;
+
+    pixel(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) :
+        r{r}, g{g}, b{b}, a{ a }
+    {;}
+};
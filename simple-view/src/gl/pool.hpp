@@ -0,0 +1,146 @@
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+// fixed set of worker threads running queued tasks
+class thread_pool
+{
+    std::vector<std::thread> __workers;
+    std::deque<std::function<void()>> __tasks;
+
+    std::mutex __mutex;
+    std::condition_variable __wake;
+
+    bool __stop = false;
+
+public:
+    // threads = 0 uses every core
+    explicit thread_pool(unsigned threads = 0)
+    {
+        if (!threads)
+        {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        for (unsigned i = 0; i < threads; ++i)
+        {
+            __workers.emplace_back(&thread_pool::worker, this);
+        }
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    ~thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(__mutex);
+
+            __stop = true;
+        }
+
+        __wake.notify_all();
+
+        for (auto& worker : __workers)
+        {
+            worker.join();
+        }
+    }
+
+    unsigned size() const
+    {
+        return static_cast<unsigned>(__workers.size());
+    }
+
+    void submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(__mutex);
+
+            __tasks.push_back(std::move(task));
+        }
+
+        __wake.notify_one();
+    }
+
+    // runs f(0) .. f(count - 1) on the pool and the calling thread, returns
+    // when all are done. the caller takes part in the work, so it is safe to
+    // call from inside a task even when every worker is busy
+    template<class F>
+    void parallel_for(int count, F&& f)
+    {
+        struct state
+        {
+            std::atomic<int> next{ 0 };
+            std::atomic<int> done{ 0 };
+
+            std::mutex mutex;
+            std::condition_variable finished;
+        };
+
+        auto shared = std::make_shared<state>();
+
+        std::function<void(int)> body = std::ref(f);
+
+        auto run = [shared, count, body]() {
+            int index;
+
+            while ((index = shared->next.fetch_add(1)) < count)
+            {
+                body(index);
+
+                if (shared->done.fetch_add(1) + 1 == count)
+                {
+                    std::lock_guard<std::mutex> lock(shared->mutex);
+
+                    shared->finished.notify_all();
+                }
+            }
+        };
+
+        const int helpers = std::min<int>(count - 1, size());
+
+        for (int i = 0; i < helpers; ++i)
+        {
+            submit(run);
+        }
+
+        run();
+
+        std::unique_lock<std::mutex> lock(shared->mutex);
+
+        shared->finished.wait(lock, [&shared, count]() { return shared->done == count; });
+    }
+
+private:
+    void worker()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+
+            {
+                std::unique_lock<std::mutex> lock(__mutex);
+
+                __wake.wait(lock, [this]() { return __stop || !__tasks.empty(); });
+
+                if (__tasks.empty())
+                {
+                    break;
+                }
+
+                task = std::move(__tasks.front());
+                __tasks.pop_front();
+            }
+
+            task();
+        }
+    }
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <chrono>
+#include <algorithm>
+
+// progressive refinement of a frame
+//
+// the first pass evaluates one sample per coarse block and fills the whole
+// block with it, every next pass halves the block size and only evaluates
+// the samples the previous passes have not produced yet, so the last pass
+// (step 1) completes the full resolution frame without any duplicated work
+//
+// the work of a pass is split into groups of samples and resumed on the next
+// call, mid-row if needed, when the time budget runs out
+class refinement
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    static constexpr int coarse_step = 8;
+
+    // samples evaluated between two looks at the clock
+    static constexpr int check_interval = 16;
+
+private:
+    int __step = coarse_step;
+    int __row = 0;
+    int __col = 0;
+
+    // rows touched by the last advance() call, [first, last)
+    int __dirty_first = 0;
+    int __dirty_last = 0;
+
+public:
+    refinement() = default;
+
+    void restart()
+    {
+        __step = coarse_step;
+        __row = 0;
+        __col = 0;
+        __dirty_first = 0;
+        __dirty_last = 0;
+    }
+
+    bool done() const
+    {
+        return __step == 0;
+    }
+
+    int step() const
+    {
+        return __step;
+    }
+
+    int dirty_first() const
+    {
+        return __dirty_first;
+    }
+
+    int dirty_last() const
+    {
+        return __dirty_last;
+    }
+
+    bool dirty() const
+    {
+        return __dirty_first < __dirty_last;
+    }
+
+    // evaluates samples until the frame is complete or the budget is spent,
+    // the budget is checked every check_interval samples and at the end of a
+    // row so at least one sample is always done
+    template<class T, class shader>
+    bool advance(T* data, int width, int height, shader&& shade, clock::duration budget)
+    {
+        __dirty_first = height;
+        __dirty_last = 0;
+
+        const auto deadline = clock::now() + budget;
+
+        int samples = 0;
+        bool expired = false;
+
+        while (!done() && !expired)
+        {
+            const int step = __step;
+            const int i = __row;
+
+            // samples with both coordinates on the doubled grid are already done
+            const bool odd_row = (step == coarse_step) || (i % (step * 2)) != 0;
+            const int j_first = std::max(__col, odd_row ? 0 : step);
+            const int j_step = odd_row ? step : step * 2;
+
+            const int rows = std::min(step, height - i);
+
+            for (int j = j_first; j < width; j += j_step)
+            {
+                const T value = shade(i, j);
+                const int cols = std::min(step, width - j);
+
+                for (int y = 0; y < rows; ++y)
+                {
+                    std::fill_n(&data[(i + y) * width + j], cols, value);
+                }
+
+                __col = j + j_step;
+
+                if (++samples % check_interval == 0 && clock::now() >= deadline)
+                {
+                    expired = true;
+                    break;
+                }
+            }
+
+            if (j_first < width)
+            {
+                __dirty_first = std::min(__dirty_first, i);
+                __dirty_last = std::max(__dirty_last, i + rows);
+            }
+
+            // resumed at __col on the next call
+            if (__col < width && expired)
+            {
+                break;
+            }
+
+            __col = 0;
+            __row += step;
+
+            if (__row >= height)
+            {
+                __row = 0;
+                __step /= 2;
+            }
+
+            expired = expired || clock::now() >= deadline;
+        }
+
+        return dirty();
+    }
+};
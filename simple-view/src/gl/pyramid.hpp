@@ -0,0 +1,626 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include "pixel.hpp"
+
+#if defined(_WIN32)
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   ifndef WIN32_LEAN_AND_MEAN
+#       define WIN32_LEAN_AND_MEAN
+#   endif
+#   include <Windows.h>
+#else
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#endif
+
+// tiled, mipmapped image pyramid on disk
+//
+// level 0 is the full image, every next level halves both sizes (2x2 box
+// filter) until the image fits into one tile. every level is split into
+// square tiles of rgba pixels stored bottom row first like gl textures,
+// edge tiles are padded with transparent pixels. tiles start on page
+// boundaries so a tile can be mapped and released on its own
+//
+//   header
+//   level levels[header.levels]
+//   (padding up to header.data_offset)
+//   tiles, each tile_size * tile_size * 4 bytes
+//   uint64_t offsets[sum of columns * rows], 0 for a tile never written
+struct pyramid_layout
+{
+    static constexpr char magic[8] = { 'S', 'V', 'P', 'Y', 'R', 'A', 'M', '1' };
+
+    static constexpr uint64_t alignment = 4096;
+
+    struct header
+    {
+        char     magic[8];
+        uint32_t version;
+        uint32_t tile_size;
+        uint64_t width;
+        uint64_t height;
+        uint32_t levels;
+        uint32_t pixel_size;
+        uint64_t data_offset;
+        uint64_t index_offset;
+    };
+
+    struct level
+    {
+        uint64_t width;
+        uint64_t height;
+        uint32_t columns;
+        uint32_t rows;
+        uint64_t first_tile;
+    };
+
+    static std::vector<level> levels_for(uint64_t width, uint64_t height, uint32_t tile_size)
+    {
+        std::vector<level> levels;
+
+        uint64_t first = 0;
+
+        while (true)
+        {
+            level l{};
+
+            l.width = width;
+            l.height = height;
+            l.columns = static_cast<uint32_t>((width + tile_size - 1) / tile_size);
+            l.rows = static_cast<uint32_t>((height + tile_size - 1) / tile_size);
+            l.first_tile = first;
+
+            levels.push_back(l);
+
+            first += static_cast<uint64_t>(l.columns) * l.rows;
+
+            if (width <= tile_size && height <= tile_size)
+            {
+                break;
+            }
+
+            width = (width + 1) / 2;
+            height = (height + 1) / 2;
+        }
+
+        return levels;
+    }
+
+    static uint64_t tile_bytes(uint32_t tile_size)
+    {
+        return static_cast<uint64_t>(tile_size) * tile_size * sizeof(pixel);
+    }
+
+    // tiles of a multiple of 32 pixels are whole pages
+    static constexpr uint32_t tile_granularity = 32;
+
+    static bool valid_tile_size(uint32_t tile_size)
+    {
+        return tile_size && tile_size % tile_granularity == 0;
+    }
+};
+
+// builds a pyramid from rows pushed bottom to top, only one band of
+// tile_size rows per level is kept in memory
+class pyramid_writer
+{
+    struct level_state
+    {
+        pyramid_layout::level info;
+
+        // rows of the band not written yet
+        std::vector<pixel> band;
+        uint32_t band_rows = 0;
+
+        uint64_t row = 0;
+
+        // row waiting for its pair to be averaged into the next level
+        std::vector<pixel> pending;
+        bool has_pending = false;
+    };
+
+    std::FILE* __file = nullptr;
+
+    pyramid_layout::header __header{};
+
+    std::vector<level_state> __levels;
+    std::vector<uint64_t> __offsets;
+
+    std::vector<pixel> __tile;
+    std::vector<pixel> __down;
+
+    uint64_t __offset = 0;
+
+public:
+    pyramid_writer() = default;
+
+    pyramid_writer(const pyramid_writer&) = delete;
+    pyramid_writer& operator=(const pyramid_writer&) = delete;
+
+    ~pyramid_writer()
+    {
+        if (__file)
+        {
+            std::fclose(__file);
+        }
+    }
+
+    // tile_size has to be a multiple of pyramid_layout::tile_granularity
+    bool open(const std::string& path, uint64_t width, uint64_t height, uint32_t tile_size = 256)
+    {
+        if (!width || !height || !pyramid_layout::valid_tile_size(tile_size))
+        {
+            return false;
+        }
+
+        __file = std::fopen(path.c_str(), "wb");
+
+        if (!__file)
+        {
+            return false;
+        }
+
+        auto levels = pyramid_layout::levels_for(width, height, tile_size);
+
+        std::memcpy(__header.magic, pyramid_layout::magic, sizeof(__header.magic));
+        __header.version = 1;
+        __header.tile_size = tile_size;
+        __header.width = width;
+        __header.height = height;
+        __header.levels = static_cast<uint32_t>(levels.size());
+        __header.pixel_size = sizeof(pixel);
+
+        const uint64_t table = sizeof(__header) + levels.size() * sizeof(pyramid_layout::level);
+
+        __header.data_offset = (table + pyramid_layout::alignment - 1) / pyramid_layout::alignment * pyramid_layout::alignment;
+
+        __levels.clear();
+
+        for (auto& l : levels)
+        {
+            level_state state;
+
+            state.info = l;
+            state.band.resize(static_cast<size_t>(l.width) * tile_size);
+            state.pending.resize(static_cast<size_t>(l.width));
+
+            __levels.push_back(std::move(state));
+        }
+
+        __offsets.assign(levels.back().first_tile + static_cast<uint64_t>(levels.back().columns) * levels.back().rows, 0);
+        __tile.resize(static_cast<size_t>(tile_size) * tile_size);
+
+        // header and level table are written again once the index is known
+        std::vector<uint8_t> head(__header.data_offset, 0);
+
+        __offset = 0;
+
+        return write(head.data(), head.size());
+    }
+
+    // next row of level 0, rows go from the bottom of the image up
+    bool push(const pixel* row)
+    {
+        return push(0, row);
+    }
+
+    bool close()
+    {
+        if (!__file)
+        {
+            return false;
+        }
+
+        bool ok = true;
+
+        __header.index_offset = __offset;
+
+        ok = ok && write(__offsets.data(), __offsets.size() * sizeof(uint64_t));
+
+        ok = ok && std::fseek(__file, 0, SEEK_SET) == 0;
+        ok = ok && std::fwrite(&__header, sizeof(__header), 1, __file) == 1;
+
+        for (auto& l : __levels)
+        {
+            ok = ok && std::fwrite(&l.info, sizeof(l.info), 1, __file) == 1;
+        }
+
+        ok = std::fclose(__file) == 0 && ok;
+        __file = nullptr;
+
+        return ok;
+    }
+
+private:
+
+    bool write(const void* data, size_t size)
+    {
+        __offset += size;
+
+        return std::fwrite(data, 1, size, __file) == size;
+    }
+
+    bool push(size_t index, const pixel* row)
+    {
+        auto& level = __levels[index];
+        const size_t width = static_cast<size_t>(level.info.width);
+
+        std::copy(row, row + width, level.band.begin() + level.band_rows * width);
+
+        ++level.band_rows;
+        ++level.row;
+
+        bool ok = true;
+
+        if (level.band_rows == __header.tile_size || level.row == level.info.height)
+        {
+            ok = flush(level);
+        }
+
+        if (index + 1 == __levels.size())
+        {
+            return ok;
+        }
+
+        const bool last = level.row == level.info.height;
+
+        if (!level.has_pending && !last)
+        {
+            std::copy(row, row + width, level.pending.begin());
+            level.has_pending = true;
+
+            return ok;
+        }
+
+        // an odd last row is paired with itself
+        const pixel* below = level.has_pending ? level.pending.data() : row;
+
+        level.has_pending = false;
+
+        const size_t half = static_cast<size_t>(__levels[index + 1].info.width);
+
+        __down.resize(half);
+
+        for (size_t j = 0; j < half; ++j)
+        {
+            const size_t a = 2 * j;
+            const size_t b = std::min(a + 1, width - 1);
+
+            auto avg = [](int p, int q, int r, int s) { return static_cast<uint8_t>((p + q + r + s + 2) / 4); };
+
+            __down[j] = pixel(
+                avg(below[a].r, below[b].r, row[a].r, row[b].r),
+                avg(below[a].g, below[b].g, row[a].g, row[b].g),
+                avg(below[a].b, below[b].b, row[a].b, row[b].b),
+                avg(below[a].a, below[b].a, row[a].a, row[b].a)
+            );
+        }
+
+        return push(index + 1, __down.data()) && ok;
+    }
+
+    bool flush(level_state& level)
+    {
+        const uint32_t size = __header.tile_size;
+        const size_t width = static_cast<size_t>(level.info.width);
+        const uint64_t band = (level.row - 1) / size;
+
+        bool ok = true;
+
+        for (uint32_t c = 0; c < level.info.columns; ++c)
+        {
+            const size_t x0 = static_cast<size_t>(c) * size;
+            const size_t cols = std::min<size_t>(size, width - x0);
+
+            std::fill(__tile.begin(), __tile.end(), pixel(0, 0, 0, 0));
+
+            for (uint32_t v = 0; v < level.band_rows; ++v)
+            {
+                auto first = level.band.begin() + v * width + x0;
+
+                std::copy(first, first + cols, __tile.begin() + static_cast<size_t>(v) * size);
+            }
+
+            __offsets[level.info.first_tile + band * level.info.columns + c] = __offset;
+
+            ok = ok && write(__tile.data(), __tile.size() * sizeof(pixel));
+        }
+
+        level.band_rows = 0;
+
+        return ok;
+    }
+};
+
+// memory mapped pyramid, tiles are read straight from the mapping and can
+// be released afterwards so the resident set stays bounded by the tiles in use
+class pyramid_reader
+{
+    const uint8_t* __data = nullptr;
+    uint64_t __size = 0;
+
+#if defined(_WIN32)
+    HANDLE __file = INVALID_HANDLE_VALUE;
+    HANDLE __mapping = NULL;
+#else
+    int __fd = -1;
+#endif
+
+    pyramid_layout::header __header{};
+
+    const pyramid_layout::level* __levels = nullptr;
+    const uint64_t* __offsets = nullptr;
+
+public:
+    pyramid_reader() = default;
+
+    pyramid_reader(const pyramid_reader&) = delete;
+    pyramid_reader& operator=(const pyramid_reader&) = delete;
+
+    ~pyramid_reader()
+    {
+        close();
+    }
+
+    bool open(const std::string& path)
+    {
+        close();
+
+        if (!map(path))
+        {
+            return false;
+        }
+
+        if (__size < sizeof(__header))
+        {
+            close();
+            return false;
+        }
+
+        std::memcpy(&__header, __data, sizeof(__header));
+
+        const uint64_t tables = sizeof(__header) + static_cast<uint64_t>(__header.levels) * sizeof(pyramid_layout::level);
+
+        if (std::memcmp(__header.magic, pyramid_layout::magic, sizeof(__header.magic)) || __header.pixel_size != sizeof(pixel) || !pyramid_layout::valid_tile_size(__header.tile_size) || !__header.levels || tables > __size || __header.index_offset > __size)
+        {
+            close();
+            return false;
+        }
+
+        __levels = reinterpret_cast<const pyramid_layout::level*>(__data + sizeof(__header));
+        __offsets = reinterpret_cast<const uint64_t*>(__data + __header.index_offset);
+
+        const auto& top = __levels[__header.levels - 1];
+        const uint64_t tiles = top.first_tile + static_cast<uint64_t>(top.columns) * top.rows;
+
+        if (__header.index_offset + tiles * sizeof(uint64_t) > __size)
+        {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void close()
+    {
+        unmap();
+
+        __levels = nullptr;
+        __offsets = nullptr;
+        __header = pyramid_layout::header{};
+    }
+
+    bool is_open() const
+    {
+        return __data != nullptr;
+    }
+
+    const pyramid_layout::header& header() const
+    {
+        return __header;
+    }
+
+    uint32_t tile_size() const
+    {
+        return __header.tile_size;
+    }
+
+    uint32_t levels() const
+    {
+        return __header.levels;
+    }
+
+    const pyramid_layout::level& level(uint32_t index) const
+    {
+        return __levels[index];
+    }
+
+    // pixels of the tile inside the mapping or nullptr when there is none
+    const pixel* tile(uint32_t index, int64_t x, int64_t y) const
+    {
+        if (index >= __header.levels || x < 0 || y < 0)
+        {
+            return nullptr;
+        }
+
+        const auto& l = __levels[index];
+
+        if (x >= l.columns || y >= l.rows)
+        {
+            return nullptr;
+        }
+
+        const uint64_t offset = __offsets[l.first_tile + y * l.columns + x];
+
+        if (!offset || offset + pyramid_layout::tile_bytes(__header.tile_size) > __size)
+        {
+            return nullptr;
+        }
+
+        return reinterpret_cast<const pixel*>(__data + offset);
+    }
+
+    // copies a tile out of the mapping and releases its pages,
+    // a tile that does not exist comes out transparent
+    bool copy(uint32_t index, int64_t x, int64_t y, pixel* data) const
+    {
+        const uint64_t count = static_cast<uint64_t>(__header.tile_size) * __header.tile_size;
+
+        if (const pixel* source = tile(index, x, y))
+        {
+            std::copy(source, source + count, data);
+
+            release(source);
+
+            return true;
+        }
+
+        std::fill(data, data + count, pixel(0, 0, 0, 0));
+
+        return false;
+    }
+
+    // hints the system to start reading the tile
+    void prefetch(const pixel* tile) const
+    {
+        advise(tile, true);
+    }
+
+    // drops the pages of a tile that has been copied elsewhere
+    void release(const pixel* tile) const
+    {
+        advise(tile, false);
+    }
+
+private:
+
+    void advise(const pixel* tile, bool needed) const
+    {
+        if (!tile)
+        {
+            return;
+        }
+
+#if defined(_WIN32)
+        if (!needed)
+        {
+            VirtualUnlock(const_cast<pixel*>(tile), pyramid_layout::tile_bytes(__header.tile_size));
+        }
+#else
+        madvise(const_cast<pixel*>(tile), pyramid_layout::tile_bytes(__header.tile_size), needed ? MADV_WILLNEED : MADV_DONTNEED);
+#endif
+    }
+
+    bool map(const std::string& path)
+    {
+#if defined(_WIN32)
+        __file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+
+        if (__file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER size;
+
+        if (!GetFileSizeEx(__file, &size) || !size.QuadPart)
+        {
+            unmap();
+            return false;
+        }
+
+        __size = static_cast<uint64_t>(size.QuadPart);
+        __mapping = CreateFileMappingA(__file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+        if (!__mapping)
+        {
+            unmap();
+            return false;
+        }
+
+        __data = static_cast<const uint8_t*>(MapViewOfFile(__mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+        __fd = ::open(path.c_str(), O_RDONLY);
+
+        if (__fd < 0)
+        {
+            return false;
+        }
+
+        struct stat info;
+
+        if (fstat(__fd, &info) != 0 || info.st_size <= 0)
+        {
+            unmap();
+            return false;
+        }
+
+        __size = static_cast<uint64_t>(info.st_size);
+
+        void* data = mmap(nullptr, __size, PROT_READ, MAP_SHARED, __fd, 0);
+
+        __data = data == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(data);
+
+        if (__data)
+        {
+            // tiles are visited in view order, not file order
+            madvise(data, __size, MADV_RANDOM);
+        }
+#endif
+
+        if (!__data)
+        {
+            unmap();
+            return false;
+        }
+
+        return true;
+    }
+
+    void unmap()
+    {
+#if defined(_WIN32)
+        if (__data)
+        {
+            UnmapViewOfFile(__data);
+        }
+
+        if (__mapping)
+        {
+            CloseHandle(__mapping);
+            __mapping = NULL;
+        }
+
+        if (__file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(__file);
+            __file = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (__data)
+        {
+            munmap(const_cast<uint8_t*>(__data), __size);
+        }
+
+        if (__fd >= 0)
+        {
+            ::close(__fd);
+            __fd = -1;
+        }
+#endif
+
+        __data = nullptr;
+        __size = 0;
+    }
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <glad/glad.h>
+#include "pixel.hpp"
+
+// asynchronous framebuffer readback through two pixel pack buffers
+//
+// read() starts the transfer of the current frame into one buffer and maps
+// the other one, which was filled a frame earlier and is ready by now, so
+// the cpu never waits for the gpu to finish the copy. the last frame read
+// stays in flight until flush() hands it over
+class readback
+{
+    GLuint __pbo[2] = { 0, 0 };
+    bool __pending[2] = { false, false };
+
+    int __index = 0;
+
+    int __width = 0;
+    int __height = 0;
+
+public:
+    readback() = default;
+
+    readback(const readback&) = delete;
+    readback& operator=(const readback&) = delete;
+
+    ~readback()
+    {
+        release();
+    }
+
+    void init(int width, int height)
+    {
+        release();
+
+        __width = width;
+        __height = height;
+
+        glGenBuffers(2, __pbo);
+
+        for (GLuint pbo : __pbo)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+            glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(width) * height * sizeof(pixel), nullptr, GL_STREAM_READ);
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    int width() const
+    {
+        return __width;
+    }
+
+    int height() const
+    {
+        return __height;
+    }
+
+    // a frame has been read but not handed over yet
+    bool pending() const
+    {
+        return __pending[0] || __pending[1];
+    }
+
+    // consume is called with the frame read on the previous call
+    template<class F>
+    void read(F&& consume)
+    {
+        if (!__pbo[0])
+        {
+            return;
+        }
+
+        const int next = 1 - __index;
+
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, __pbo[__index]);
+        glReadPixels(0, 0, __width, __height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+        __pending[__index] = true;
+
+        deliver(next, consume);
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        __index = next;
+    }
+
+    // hands over the frame still in flight, waits for its transfer
+    template<class F>
+    void flush(F&& consume)
+    {
+        deliver(1 - __index, consume);
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    void release()
+    {
+        if (__pbo[0])
+        {
+            glDeleteBuffers(2, __pbo);
+
+            __pbo[0] = __pbo[1] = 0;
+        }
+
+        __pending[0] = __pending[1] = false;
+        __index = 0;
+    }
+
+private:
+    template<class F>
+    void deliver(int index, F& consume)
+    {
+        if (!__pending[index])
+        {
+            return;
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, __pbo[index]);
+
+        if (auto* data = static_cast<const pixel*>(glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY)))
+        {
+            consume(data, __width, __height);
+
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+
+        __pending[index] = false;
+    }
+};
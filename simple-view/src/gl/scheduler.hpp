@@ -0,0 +1,145 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+#include <atomic>
+#include <chrono>
+#include <optional>
+
+// decides when the next frame is drawn
+//
+// instead of drawing on every loop iteration the window thread sleeps in
+// glfwWaitEvents until something asks for a frame: input or a resize
+// (request), another thread that produced new content (notify) or an
+// animation timer (request_after). an optional frame rate cap spaces the
+// frames out, vsync is left to the swap interval
+class scheduler
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+private:
+    bool __redraw = true;
+
+    std::atomic<bool> __notified{ false };
+
+    std::optional<clock::time_point> __timer;
+
+    clock::duration __interval{ 0 };
+    clock::time_point __last{};
+
+public:
+    scheduler() = default;
+
+    // limits the frame rate, 0 removes the limit
+    void set_max_fps(double fps)
+    {
+        if (fps > 0)
+        {
+            __interval = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / fps));
+        }
+        else
+        {
+            __interval = clock::duration{ 0 };
+        }
+    }
+
+    // requires a current context
+    void set_vsync(bool enabled)
+    {
+        glfwSwapInterval(enabled ? 1 : 0);
+    }
+
+    // window thread: the next frame is needed as soon as possible
+    void request()
+    {
+        __redraw = true;
+    }
+
+    // window thread: a frame is needed after the delay
+    void request_after(clock::duration delay)
+    {
+        auto when = clock::now() + delay;
+
+        if (!__timer || when < *__timer)
+        {
+            __timer = when;
+        }
+    }
+
+    // any thread: new content is ready, wakes the window thread up
+    void notify()
+    {
+        __notified = true;
+
+        glfwPostEmptyEvent();
+    }
+
+    // window thread: no frame has been asked for yet
+    bool idle() const
+    {
+        return !__redraw && !__timer && !__notified;
+    }
+
+    // processes events and blocks until a frame is due,
+    // returns false when the window is about to close
+    bool wait(GLFWwindow* window)
+    {
+        glfwPollEvents();
+
+        while (!glfwWindowShouldClose(window))
+        {
+            if (__notified.exchange(false))
+            {
+                __redraw = true;
+            }
+
+            auto now = clock::now();
+
+            if (__timer && *__timer <= now)
+            {
+                __timer.reset();
+                __redraw = true;
+            }
+
+            if (__redraw)
+            {
+                auto due = __last + __interval;
+
+                if (now >= due)
+                {
+                    return true;
+                }
+
+                wait_until(due);
+            }
+            else if (__timer)
+            {
+                wait_until(*__timer);
+            }
+            else
+            {
+                glfwWaitEvents();
+            }
+        }
+
+        return false;
+    }
+
+    // the frame has been drawn and swapped
+    void presented()
+    {
+        __redraw = false;
+        __last = clock::now();
+    }
+
+private:
+    static void wait_until(clock::time_point when)
+    {
+        std::chrono::duration<double> timeout = when - clock::now();
+
+        if (timeout.count() > 0)
+        {
+            glfwWaitEventsTimeout(timeout.count());
+        }
+    }
+};
@@ -0,0 +1,295 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include "decode.hpp"
+
+// images of a directory loaded into one GL_TEXTURE_2D_ARRAY
+//
+// the sizes come from the file headers, then the files are read and
+// decoded straight into their regions of a mapped pixel unpack buffer and
+// uploaded from there, one batch of at most batch_size bytes at a time so
+// the buffer does not grow with the directory. a file is read by the task
+// that decodes it and freed right after, so only as many files as there are
+// threads are in memory. layers are as large as the largest image, smaller
+// images occupy the bottom left corner of their layer and the rest is
+// transparent. images larger than GL_MAX_TEXTURE_SIZE and the files past
+// GL_MAX_ARRAY_TEXTURE_LAYERS are left out
+class texture_array
+{
+public:
+    struct layer
+    {
+        std::string name;
+
+        int width = 0;
+        int height = 0;
+    };
+
+    GLuint texture = 0;
+
+    int width = 0;
+    int height = 0;
+
+    std::vector<layer> layers;
+
+    // bytes of decoded pixels staged per upload, a batch holds at least one image
+    size_t batch_size = 64 << 20;
+
+    texture_array() = default;
+
+    texture_array(const texture_array&) = delete;
+    texture_array& operator=(const texture_array&) = delete;
+
+    ~texture_array()
+    {
+        release();
+    }
+
+    static bool supported(const std::filesystem::path& path)
+    {
+        auto ext = path.extension().string();
+
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+
+        return ext == ".bmp" || ext == ".ppm" || ext == ".pgm" || ext == ".tga";
+    }
+
+    // gl thread, returns the number of layers loaded
+    size_t load(const std::string& directory, decoder& dec)
+    {
+        release();
+
+        std::vector<std::string> files;
+        std::error_code error;
+
+        for (auto& entry : std::filesystem::directory_iterator(directory, error))
+        {
+            if (entry.is_regular_file() && supported(entry.path()))
+            {
+                files.push_back(entry.path().string());
+            }
+        }
+
+        std::sort(files.begin(), files.end());
+
+        std::vector<layer> found(files.size());
+
+        dec.pool().parallel_for(static_cast<int>(files.size()), [&](int k) {
+            if (decoder::peek(files[k], found[k].width, found[k].height))
+            {
+                found[k].name = files[k];
+            }
+        });
+
+        GLint max_size = 0;
+        GLint max_layers = 0;
+
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+
+        std::vector<layer> candidates;
+
+        for (auto& l : found)
+        {
+            if (!l.name.empty() && l.width <= max_size && l.height <= max_size && candidates.size() < static_cast<size_t>(max_layers))
+            {
+                width = std::max(width, l.width);
+                height = std::max(height, l.height);
+
+                candidates.push_back(l);
+            }
+        }
+
+        if (candidates.empty())
+        {
+            width = 0;
+            height = 0;
+
+            return 0;
+        }
+
+        // candidates [batches[b], batches[b + 1]) share the buffer,
+        // offsets are relative to the start of their batch
+        std::vector<size_t> batches{ 0 };
+        std::vector<size_t> offsets;
+
+        size_t capacity = 0;
+        size_t used = 0;
+
+        for (size_t k = 0; k < candidates.size(); ++k)
+        {
+            const size_t size = static_cast<size_t>(candidates[k].width) * candidates[k].height * sizeof(pixel);
+
+            if (used && used + size > batch_size)
+            {
+                batches.push_back(k);
+                used = 0;
+            }
+
+            offsets.push_back(used);
+            used += size;
+
+            capacity = std::max(capacity, used);
+        }
+
+        batches.push_back(candidates.size());
+
+        // transparent source for the padding of smaller layers, behind the batch
+        const size_t padding = capacity;
+        const size_t padding_size = static_cast<size_t>(width) * height * sizeof(pixel);
+
+        GLuint staging = 0;
+
+        glGenBuffers(1, &staging);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(capacity + padding_size), nullptr, GL_STREAM_DRAW);
+
+        auto* zeros = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, static_cast<GLintptr>(padding), static_cast<GLsizeiptr>(padding_size), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+
+        if (zeros)
+        {
+            std::memset(zeros, 0, padding_size);
+
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+            // files that changed or failed to decode since the headers were read
+            // are left out, their layers stay unused at the end of the array
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, static_cast<GLsizei>(candidates.size()), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+            const void* zero = reinterpret_cast<const void*>(padding);
+
+            for (size_t b = 0; b + 1 < batches.size(); ++b)
+            {
+                const size_t first = batches[b];
+                const size_t count = batches[b + 1] - first;
+
+                const size_t size = offsets[first + count - 1] + static_cast<size_t>(candidates[first + count - 1].width) * candidates[first + count - 1].height * sizeof(pixel);
+
+                auto* mapped = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(size), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT));
+
+                if (!mapped)
+                {
+                    break;
+                }
+
+                std::vector<char> decoded(count, 0);
+
+                dec.pool().parallel_for(static_cast<int>(count), [&](int i) {
+                    std::vector<uint8_t> bytes;
+
+                    auto& l = candidates[first + i];
+
+                    decoded[i] = decoder::read_file(l.name, bytes) && dec.decode_into(bytes.data(), bytes.size(), reinterpret_cast<pixel*>(mapped + offsets[first + i]), l.width, l.height);
+                });
+
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    if (!decoded[i])
+                    {
+                        continue;
+                    }
+
+                    auto& l = candidates[first + i];
+
+                    const GLint z = static_cast<GLint>(layers.size());
+                    const int w = l.width;
+                    const int h = l.height;
+
+                    const void* offset = reinterpret_cast<const void*>(offsets[first + i]);
+
+                    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, z, w, h, 1, GL_RGBA, GL_UNSIGNED_BYTE, offset);
+
+                    // right of the image and above it
+                    if (w < width)
+                    {
+                        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, w, 0, z, width - w, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, zero);
+                    }
+
+                    if (h < height)
+                    {
+                        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, h, z, w, height - h, 1, GL_RGBA, GL_UNSIGNED_BYTE, zero);
+                    }
+
+                    layers.push_back(l);
+                }
+            }
+
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        }
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &staging);
+
+        if (layers.empty())
+        {
+            release();
+        }
+
+        return layers.size();
+    }
+
+    // gl thread, copies a layer back into an image, e.g. for the explorer
+    // whose fixed function pipeline cannot sample an array texture
+    image read(size_t k) const
+    {
+        image result;
+
+        if (!texture || k >= layers.size())
+        {
+            return result;
+        }
+
+        GLuint fbo = 0;
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0, static_cast<GLint>(k));
+
+        if (glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE)
+        {
+            result.width = layers[k].width;
+            result.height = layers[k].height;
+            result.pixels.reset(new pixel[static_cast<size_t>(result.width) * result.height]);
+
+            glReadBuffer(GL_COLOR_ATTACHMENT0);
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            glReadPixels(0, 0, result.width, result.height, GL_RGBA, GL_UNSIGNED_BYTE, result.pixels.get());
+        }
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &fbo);
+
+        return result;
+    }
+
+    void release()
+    {
+        if (texture)
+        {
+            glDeleteTextures(1, &texture);
+            texture = 0;
+        }
+
+        width = 0;
+        height = 0;
+
+        layers.clear();
+    }
+};
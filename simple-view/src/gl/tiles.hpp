@@ -0,0 +1,480 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <list>
+#include <mutex>
+#include <deque>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <condition_variable>
+#include "pixel.hpp"
+#include "kernel.hpp"
+
+// tile of the virtual canvas, a tile of level L covers size << L canvas
+// pixels in each direction and samples every (1 << L)-th of them
+struct tile_key
+{
+    int level = 0;
+    int x = 0;
+    int y = 0;
+
+    bool operator==(const tile_key& rhs) const
+    {
+        return level == rhs.level && x == rhs.x && y == rhs.y;
+    }
+};
+
+struct tile_key_hash
+{
+    size_t operator()(const tile_key& k) const
+    {
+        return (static_cast<size_t>(k.level) * 73856093u) ^ (static_cast<size_t>(static_cast<uint32_t>(k.x)) * 19349663u) ^ (static_cast<size_t>(static_cast<uint32_t>(k.y)) * 83492791u);
+    }
+};
+
+// tiles generated on demand by background threads and kept as textures
+//
+// request() replaces the list of tiles waiting for a worker with the tiles
+// the view wants next, so tiles that went out of view before a worker took
+// them are never generated. finished tiles are uploaded on the gl thread by
+// upload(), at most a few per frame, and live in an lru list bounded by the
+// memory budget; textures of evicted tiles are reused for new ones
+class tile_cache
+{
+public:
+    using generator = std::function<void(const tile_key&, pixel*, int)>;
+
+    struct stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t uploaded = 0;
+        uint64_t evicted = 0;
+    };
+
+private:
+    struct entry
+    {
+        GLuint texture = 0;
+        uint64_t frame = 0;
+
+        std::list<tile_key>::iterator lru;
+    };
+
+    struct finished
+    {
+        tile_key key;
+        uint64_t epoch;
+
+        std::vector<pixel> data;
+    };
+
+    const int __size;
+    const size_t __capacity;
+
+    // gl thread only
+    std::unordered_map<tile_key, entry, tile_key_hash> __entries;
+    std::list<tile_key> __lru;
+    std::vector<GLuint> __spare;
+
+    std::function<void(const std::vector<tile_key>&)> __prefetch;
+    std::vector<tile_key> __fresh;
+
+    uint64_t __frame = 0;
+
+    stats __stats;
+
+    // shared with the workers
+    std::mutex __mutex;
+    std::condition_variable __wake;
+
+    std::deque<tile_key> __pending;
+    std::unordered_set<tile_key, tile_key_hash> __running;
+    std::vector<finished> __ready;
+
+    generator __generate;
+    std::function<void()> __listener;
+
+    uint64_t __epoch = 0;
+    bool __stop = false;
+
+    std::vector<std::thread> __workers;
+
+public:
+    // budget in bytes of texture memory, threads = 0 uses all cores but one
+    tile_cache(int size = 256, size_t budget = 256 << 20, unsigned threads = 0) :
+        __size{ size },
+        __capacity{ std::max<size_t>(1, budget / (static_cast<size_t>(size) * size * sizeof(pixel))) }
+    {
+        if (!threads)
+        {
+            // hardware_concurrency() is 0 when unknown
+            const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+            threads = std::max(1u, cores - 1);
+        }
+
+        for (unsigned i = 0; i < threads; ++i)
+        {
+            __workers.emplace_back(&tile_cache::worker, this);
+        }
+    }
+
+    tile_cache(const tile_cache&) = delete;
+    tile_cache& operator=(const tile_cache&) = delete;
+
+    ~tile_cache()
+    {
+        {
+            std::lock_guard<std::mutex> lock(__mutex);
+
+            __stop = true;
+        }
+
+        __wake.notify_all();
+
+        for (auto& worker : __workers)
+        {
+            worker.join();
+        }
+    }
+
+    int size() const
+    {
+        return __size;
+    }
+
+    size_t capacity() const
+    {
+        return __capacity;
+    }
+
+    const stats& statistics() const
+    {
+        return __stats;
+    }
+
+    // per-pixel kernels only, i and j are canvas coordinates
+    template<class K>
+    void set_kernel(K k)
+    {
+        auto fused = kernel::as_fused(k);
+
+        static_assert(kernel::is_per_pixel<decltype(fused)>::value, "tiles are sampled, use a per-pixel kernel");
+
+        set_generator([fused](const tile_key& key, pixel* data, int size) {
+            for (int v = 0; v < size; ++v)
+            {
+                const int i = (key.y * size + v) << key.level;
+
+                for (int u = 0; u < size; ++u)
+                {
+                    data[v * size + u] = kernel::sample(fused, i, (key.x * size + u) << key.level);
+                }
+            }
+        });
+    }
+
+    void set_generator(generator g)
+    {
+        std::lock_guard<std::mutex> lock(__mutex);
+
+        __generate = std::move(g);
+
+        drop();
+    }
+
+    // called from a worker thread whenever a tile is ready for upload
+    void set_listener(std::function<void()> f)
+    {
+        std::lock_guard<std::mutex> lock(__mutex);
+
+        __listener = std::move(f);
+    }
+
+    // gl thread, called from request() with the tiles that were just
+    // queued, lets a file backed generator start reading them all at once
+    void set_prefetcher(std::function<void(const std::vector<tile_key>&)> f)
+    {
+        __prefetch = std::move(f);
+    }
+
+    // gl thread, starts a frame so tiles used by it are not evicted
+    void begin_frame()
+    {
+        ++__frame;
+    }
+
+    // gl thread, texture of a cached tile or 0
+    GLuint find(const tile_key& key)
+    {
+        auto it = __entries.find(key);
+
+        if (it == __entries.end())
+        {
+            ++__stats.misses;
+            return 0;
+        }
+
+        ++__stats.hits;
+
+        it->second.frame = __frame;
+        __lru.splice(__lru.begin(), __lru, it->second.lru);
+
+        return it->second.texture;
+    }
+
+    bool contains(const tile_key& key) const
+    {
+        return __entries.count(key) != 0;
+    }
+
+    // gl thread, wanted tiles in priority order
+    void request(const std::vector<tile_key>& wanted)
+    {
+        __fresh.clear();
+
+        {
+            std::lock_guard<std::mutex> lock(__mutex);
+
+            std::unordered_set<tile_key, tile_key_hash> queued;
+
+            if (__prefetch)
+            {
+                queued.insert(__pending.begin(), __pending.end());
+            }
+
+            __pending.clear();
+
+            for (auto& key : wanted)
+            {
+                if (!contains(key) && !__running.count(key))
+                {
+                    __pending.push_back(key);
+
+                    if (__prefetch && !queued.count(key))
+                    {
+                        __fresh.push_back(key);
+                    }
+                }
+            }
+        }
+
+        if (!__fresh.empty())
+        {
+            __prefetch(__fresh);
+        }
+
+        __wake.notify_all();
+    }
+
+    bool has_ready()
+    {
+        std::lock_guard<std::mutex> lock(__mutex);
+
+        return !__ready.empty();
+    }
+
+    // gl thread, moves up to max finished tiles into textures
+    int upload(int max)
+    {
+        std::vector<finished> batch;
+
+        {
+            std::lock_guard<std::mutex> lock(__mutex);
+
+            const size_t count = std::min<size_t>(max, __ready.size());
+
+            batch.assign(std::make_move_iterator(__ready.begin()), std::make_move_iterator(__ready.begin() + count));
+
+            __ready.erase(__ready.begin(), __ready.begin() + count);
+
+            for (auto& tile : batch)
+            {
+                __running.erase(tile.key);
+            }
+        }
+
+        int uploaded = 0;
+
+        for (auto& tile : batch)
+        {
+            if (tile.epoch != __epoch || contains(tile.key))
+            {
+                continue;
+            }
+
+            GLuint texture = acquire();
+
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, __size, __size, GL_RGBA, GL_UNSIGNED_BYTE, tile.data.data());
+
+            __lru.push_front(tile.key);
+            __entries[tile.key] = entry{ texture, __frame, __lru.begin() };
+
+            ++__stats.uploaded;
+            ++uploaded;
+        }
+
+        evict();
+
+        return uploaded;
+    }
+
+    // gl thread, forgets every tile, e.g. after the kernel has changed
+    void clear()
+    {
+        {
+            std::lock_guard<std::mutex> lock(__mutex);
+
+            drop();
+        }
+
+        for (auto& item : __entries)
+        {
+            __spare.push_back(item.second.texture);
+        }
+
+        __entries.clear();
+        __lru.clear();
+    }
+
+    // gl thread, deletes the textures, the cache stays usable
+    void release()
+    {
+        clear();
+
+        if (!__spare.empty())
+        {
+            glDeleteTextures(static_cast<GLsizei>(__spare.size()), __spare.data());
+
+            __spare.clear();
+        }
+    }
+
+private:
+
+    // requires the lock
+    void drop()
+    {
+        ++__epoch;
+
+        for (auto& tile : __ready)
+        {
+            __running.erase(tile.key);
+        }
+
+        __pending.clear();
+        __ready.clear();
+    }
+
+    GLuint acquire()
+    {
+        if (!__spare.empty())
+        {
+            GLuint texture = __spare.back();
+
+            __spare.pop_back();
+
+            return texture;
+        }
+
+        GLuint texture = 0;
+
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, __size, __size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+        return texture;
+    }
+
+    // tiles used by the current frame stay even above the budget
+    void evict()
+    {
+        while (__entries.size() > __capacity)
+        {
+            auto it = __entries.find(__lru.back());
+
+            if (it->second.frame == __frame)
+            {
+                break;
+            }
+
+            __spare.push_back(it->second.texture);
+
+            __entries.erase(it);
+            __lru.pop_back();
+
+            ++__stats.evicted;
+        }
+    }
+
+    void worker()
+    {
+        std::vector<pixel> data;
+
+        while (true)
+        {
+            tile_key key;
+            uint64_t epoch;
+            generator generate;
+
+            {
+                std::unique_lock<std::mutex> lock(__mutex);
+
+                __wake.wait(lock, [this]() { return __stop || (!__pending.empty() && __generate); });
+
+                if (__stop)
+                {
+                    break;
+                }
+
+                key = __pending.front();
+                __pending.pop_front();
+
+                __running.insert(key);
+
+                epoch = __epoch;
+                generate = __generate;
+            }
+
+            data.resize(static_cast<size_t>(__size) * __size);
+
+            generate(key, data.data(), __size);
+
+            std::function<void()> listener;
+
+            {
+                std::lock_guard<std::mutex> lock(__mutex);
+
+                if (epoch == __epoch)
+                {
+                    __ready.push_back(finished{ key, epoch, std::move(data) });
+
+                    listener = __listener;
+                }
+                else
+                {
+                    __running.erase(key);
+                }
+            }
+
+            data = std::vector<pixel>();
+
+            if (listener)
+            {
+                listener();
+            }
+        }
+    }
+};
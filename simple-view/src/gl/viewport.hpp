@@ -0,0 +1,242 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "tiles.hpp"
+
+// pan and zoom over a large virtual canvas drawn from a tile_cache
+//
+// (x, y) is the canvas point at the bottom left corner of the window and
+// scale the number of window pixels per canvas pixel. zooming out switches
+// to coarser tile levels, zooming in magnifies level 0 tiles. tiles in the
+// direction of the last motion are requested after the visible ones
+class viewport
+{
+public:
+    double x = 0;
+    double y = 0;
+    double scale = 1;
+
+    int width = 640;
+    int height = 480;
+
+    double canvas_width = 1 << 20;
+    double canvas_height = 1 << 20;
+
+    // coarsest tile level the source provides
+    int max_level = 30;
+
+    // rings of tiles prefetched ahead of the motion
+    int prefetch = 2;
+
+    // finished tiles moved into textures per frame
+    int uploads_per_frame = 8;
+
+    // levels searched upwards for a stand-in of a missing tile
+    int fallback_levels = 4;
+
+private:
+    // last motion in canvas pixels, decays every frame
+    double __vx = 0;
+    double __vy = 0;
+
+public:
+    viewport() = default;
+
+    void resize(int w, int h)
+    {
+        width = std::max(1, w);
+        height = std::max(1, h);
+    }
+
+    // moves the view by a distance in window pixels
+    void pan(double dx, double dy)
+    {
+        __vx = -dx / scale;
+        __vy = -dy / scale;
+
+        x += __vx;
+        y += __vy;
+
+        clamp();
+    }
+
+    // zooms by factor keeping the canvas point under window point (sx, sy)
+    void zoom(double factor, double sx, double sy)
+    {
+        const double cx = x + sx / scale;
+        const double cy = y + sy / scale;
+
+        const double fit = std::min(width / canvas_width, height / canvas_height);
+
+        scale = std::clamp(scale * factor, fit, 64.0);
+
+        x = cx - sx / scale;
+        y = cy - sy / scale;
+
+        clamp();
+    }
+
+    int level() const
+    {
+        return scale >= 1 ? 0 : std::min(max_level, static_cast<int>(std::floor(std::log2(1 / scale))));
+    }
+
+    // uploads finished tiles, draws the visible ones and requests the missing,
+    // returns false while some visible tile is drawn from a coarser stand-in
+    bool draw(tile_cache& cache)
+    {
+        cache.begin_frame();
+        cache.upload(uploads_per_frame);
+
+        const int level = this->level();
+        const int size = cache.size();
+        const double span = static_cast<double>(size) * (1 << level);
+
+        const int columns = static_cast<int>(std::ceil(canvas_width / span));
+        const int rows = static_cast<int>(std::ceil(canvas_height / span));
+
+        const int x0 = std::max(0, static_cast<int>(std::floor(x / span)));
+        const int y0 = std::max(0, static_cast<int>(std::floor(y / span)));
+        const int x1 = std::min(columns - 1, static_cast<int>(std::floor((x + width / scale) / span)));
+        const int y1 = std::min(rows - 1, static_cast<int>(std::floor((y + height / scale) / span)));
+
+        std::vector<tile_key> wanted;
+
+        glMatrixMode(GL_PROJECTION);
+        glLoadIdentity();
+        glOrtho(0, width, 0, height, -1, 1);
+        glViewport(0, 0, width, height);
+
+        glClear(GL_COLOR_BUFFER_BIT);
+        glEnable(GL_TEXTURE_2D);
+        glColor3f(1, 1, 1);
+
+        bool complete = true;
+
+        for (int ty = y0; ty <= y1; ++ty)
+        {
+            for (int tx = x0; tx <= x1; ++tx)
+            {
+                tile_key key{ level, tx, ty };
+
+                if (!draw_tile(cache, key, span))
+                {
+                    wanted.push_back(key);
+                    complete = false;
+                }
+            }
+        }
+
+        glDisable(GL_TEXTURE_2D);
+
+        // nearest to the window center first
+        const double cx = (x + width / scale * 0.5) / span;
+        const double cy = (y + height / scale * 0.5) / span;
+
+        std::sort(wanted.begin(), wanted.end(), [cx, cy](const tile_key& a, const tile_key& b) {
+            return std::hypot(a.x + 0.5 - cx, a.y + 0.5 - cy) < std::hypot(b.x + 0.5 - cx, b.y + 0.5 - cy);
+        });
+
+        const int dx = __vx > 0.5 ? 1 : (__vx < -0.5 ? -1 : 0);
+        const int dy = __vy > 0.5 ? 1 : (__vy < -0.5 ? -1 : 0);
+
+        for (int ring = 1; ring <= prefetch && (dx || dy); ++ring)
+        {
+            auto ahead = [&](int tx, int ty) {
+                tile_key key{ level, tx, ty };
+
+                if (tx >= 0 && ty >= 0 && tx < columns && ty < rows && !cache.contains(key))
+                {
+                    wanted.push_back(key);
+                }
+            };
+
+            if (dx)
+            {
+                const int tx = dx > 0 ? x1 + ring : x0 - ring;
+
+                for (int ty = y0; ty <= y1; ++ty)
+                {
+                    ahead(tx, ty);
+                }
+            }
+
+            if (dy)
+            {
+                const int ty = dy > 0 ? y1 + ring : y0 - ring;
+
+                for (int tx = x0; tx <= x1; ++tx)
+                {
+                    ahead(tx, ty);
+                }
+            }
+        }
+
+        cache.request(wanted);
+
+        __vx *= 0.5;
+        __vy *= 0.5;
+
+        return complete;
+    }
+
+private:
+
+    void clamp()
+    {
+        x = std::clamp(x, 0.0, std::max(0.0, canvas_width - width / scale));
+        y = std::clamp(y, 0.0, std::max(0.0, canvas_height - height / scale));
+    }
+
+    // draws the tile or the part of a cached coarser tile covering it
+    bool draw_tile(tile_cache& cache, const tile_key& key, double span)
+    {
+        for (int up = 0; up <= fallback_levels; ++up)
+        {
+            tile_key parent{ key.level + up, key.x >> up, key.y >> up };
+
+            GLuint texture = up ? (cache.contains(parent) ? cache.find(parent) : 0) : cache.find(key);
+
+            if (!texture)
+            {
+                continue;
+            }
+
+            const int n = 1 << up;
+
+            const float s0 = static_cast<float>(key.x & (n - 1)) / n;
+            const float t0 = static_cast<float>(key.y & (n - 1)) / n;
+            const float s1 = s0 + 1.0f / n;
+            const float t1 = t0 + 1.0f / n;
+
+            const double left = (key.x * span - x) * scale;
+            const double bottom = (key.y * span - y) * scale;
+            const double right = left + span * scale;
+            const double top = bottom + span * scale;
+
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glBegin(GL_QUADS);
+
+            glTexCoord2f(s0, t0);
+            glVertex2d(left, bottom);
+
+            glTexCoord2f(s0, t1);
+            glVertex2d(left, top);
+
+            glTexCoord2f(s1, t1);
+            glVertex2d(right, top);
+
+            glTexCoord2f(s1, t0);
+            glVertex2d(right, bottom);
+
+            glEnd();
+
+            return up == 0;
+        }
+
+        return false;
+    }
+};
@@ -1,21 +1,16 @@
+#pragma once
+
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <memory>
-
-struct pixel
-{
-    uint8_t r{ 0 };
-    uint8_t g{ 0 };
-    uint8_t b{ 0 };
-
-    uint8_t a{ 255 };
-
-    pixel() = default;
-
-    pixel(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) :
-        r{r}, g{g}, b{b}, a{ a }
-    {;}
-};
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <algorithm>
+#include "gl/pixel.hpp"
+#include "gl/kernel.hpp"
+#include "gl/progressive.hpp"
+#include "gl/decode.hpp"
 
 class explorer
 {
@@ -28,14 +23,128 @@ public:
 
     int index = 0;
 
-    std::unique_ptr<pixel> texture;
+    std::unique_ptr<pixel[]> texture;
+
+    // progressive mode: a coarse frame is shown first and refined
+    // over the next frames, each frame spends at most the budget on it
+    bool progressive = false;
+
+    std::chrono::microseconds budget{ 4000 };
+
+    refinement refine;
+
+    // set when the frame has to be rendered again
+    bool outdated = true;
+
+    // incremented whenever the texture content changes
+    uint64_t generation = 0;
+
+    // the frame is a decoded image, the kernel does not run
+    bool loaded = false;
+
+    // part of the kernel plane in the frame, frame pixel (i, j) samples
+    // row view_y + i / view_scale and column view_x + j / view_scale.
+    // only per pixel kernels follow the view, the others see frame coordinates
+    double view_x = 0;
+    double view_y = 0;
+    double view_scale = 1;
+
+private:
+
+    // the registered kernel with its traversal already instantiated,
+    // called once per frame or once per refinement step
+    std::function<void(pixel*, int, int)> __render;
+    std::function<bool(refinement&, pixel*, int, int, std::chrono::microseconds)> __refine;
 
+public:
+
+    explorer()
+    {
+        set_kernel(kernel::pixels([](int i, int j) { return pixel(i, j, 0); }));
+    }
+
+    // the kernel closures refer to the view of this instance
+    explorer(const explorer&) = delete;
+    explorer& operator=(const explorer&) = delete;
+
+    template<class K>
+    void set_kernel(K k)
+    {
+        auto fused = kernel::as_fused(k);
+
+        using fused_t = decltype(fused);
+
+        if constexpr (kernel::is_per_pixel<fused_t>::value)
+        {
+            auto shader = [fused, this](int i, int j) { return kernel::sample(fused, row(i), column(j)); };
+
+            __render = [shader](pixel* data, int width, int height) {
+                kernel::traverse(kernel::as_fused(kernel::pixels(shader)), data, width, height);
+            };
+
+            __refine = [shader](refinement& refine, pixel* data, int width, int height, std::chrono::microseconds budget) {
+                return refine.advance(data, width, height, shader, budget);
+            };
+        }
+        else
+        {
+            __render = [fused](pixel* data, int width, int height) {
+                kernel::traverse(fused, data, width, height);
+            };
+
+            // row and tile kernels cannot be sampled, the frame is rendered at once
+            __refine = nullptr;
+        }
+
+        loaded = false;
+
+        invalidate();
+    }
+
+    // shows a decoded image, its buffer becomes the staging buffer
+    // of the texture and is uploaded without another copy.
+    // returns false when the image does not fit into one texture
+    bool show(image&& img)
+    {
+        if (!img)
+        {
+            return false;
+        }
+
+        GLint max_size = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+
+        if (img.width > max_size || img.height > max_size)
+        {
+            return false;
+        }
+
+        if (index)
+        {
+            glDeleteTextures(1, &textureID);
+
+            index = 0;
+        }
+
+        width = img.width;
+        height = img.height;
+
+        texture = std::move(img.pixels);
+
+        loaded = true;
+        outdated = false;
+
+        return true;
+    }
+
+    // the frame is stretched over the whole viewport whatever its size,
+    // called again when the framebuffer is resized
     void init(int ViewWidth = 640, int ViewHeight = 480)
     {
         glShadeModel(GL_SMOOTH);
-        glMatrixMode(GL_PROJECTION_MATRIX);
+        glMatrixMode(GL_PROJECTION);
         glLoadIdentity();
-        glOrtho(0, height, 0, width, -1, 1);
+        glOrtho(0, 1, 0, 1, -1, 1);
         glViewport(0, 0, ViewWidth, ViewHeight);
     }
 
@@ -58,11 +167,30 @@ public:
 
             glTexImage2D(target, 0, GL_RGBA8, width, height, 0, format, GL_UNSIGNED_BYTE, texture.get());
 
+            ++generation;
+
             glDisable(target);
         }
     }
 
-    void render_frame()
+    // uploads rows [first, last) of the frame into the existing texture
+    void Update2DTexture(int first, int last)
+    {
+        const GLenum target = GL_TEXTURE_2D;
+        const GLenum format = GL_RGBA;
+
+        if (texture && first < last)
+        {
+            glBindTexture(target, textureID);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+            glTexSubImage2D(target, 0, 0, first, width, last - first, format, GL_UNSIGNED_BYTE, texture.get() + first * width);
+
+            ++generation;
+        }
+    }
+
+    void allocate()
     {
         if (!texture)
         {
@@ -70,30 +198,112 @@ public:
 
             texture.reset(new pixel[length]);
         }
+    }
 
-        auto* data = texture.get();
+    void render_frame()
+    {
+        allocate();
 
-        for (int i = 0; i < height; ++i)
-        {
-            int offset = i * width;
+        __render(texture.get(), width, height);
+    }
 
-            for (int j = 0; j < width; ++j)
-            {
-                new (&data[offset + j]) pixel(i, j, 0);
-            }
+    // spends at most one budget on the pending refinement passes
+    void refine_frame()
+    {
+        if (__refine(refine, texture.get(), width, height, budget))
+        {
+            Update2DTexture(refine.dirty_first(), refine.dirty_last());
         }
     }
 
+    // the view has changed, the frame has to be produced from scratch
+    void invalidate()
+    {
+        refine.restart();
+
+        outdated = true;
+    }
+
+    // moves the view by dx, dy frame pixels, x to the right and y upwards
+    void pan(double dx, double dy)
+    {
+        view_x -= dx / view_scale;
+        view_y -= dy / view_scale;
+
+        clamp_view();
+        invalidate();
+    }
+
+    // scales the view around frame pixel (sx, sy)
+    void zoom(double factor, double sx, double sy)
+    {
+        const double x = view_x + sx / view_scale;
+        const double y = view_y + sy / view_scale;
+
+        view_scale = std::clamp(view_scale * factor, 1 / 64.0, 64.0);
+
+        view_x = x - sx / view_scale;
+        view_y = y - sy / view_scale;
+
+        clamp_view();
+        invalidate();
+    }
+
+    bool refining() const
+    {
+        return progressive && __refine && !loaded && !refine.done();
+    }
+
+    int row(int i) const
+    {
+        return static_cast<int>(std::floor(view_y + i / view_scale));
+    }
+
+    int column(int j) const
+    {
+        return static_cast<int>(std::floor(view_x + j / view_scale));
+    }
+
+private:
+
+    // keeps row() and column() within int for any frame pixel,
+    // a frame is at most 64k pixels wide, at 1/64 that is 2^22 plane units
+    void clamp_view()
+    {
+        constexpr double limit = 1 << 30;
+
+        view_x = std::clamp(view_x, -limit, limit);
+        view_y = std::clamp(view_y, -limit, limit);
+    }
+
+public:
+
     void DrawTexture()
     {
         if (!index)
         {
-            render_frame();
+            allocate();
             Load2DTexture();
 
             index = 1;
         }
 
+        if (outdated && !loaded)
+        {
+            if (!progressive || !__refine)
+            {
+                render_frame();
+                Update2DTexture(0, height);
+            }
+
+            outdated = false;
+        }
+
+        if (refining())
+        {
+            refine_frame();
+        }
+
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         glEnable(GL_TEXTURE_2D);
@@ -107,13 +317,13 @@ public:
         glVertex2i(0, 0);
 
         glTexCoord2f(0.0f, 1.0f);
-        glVertex2i(0, height);
+        glVertex2i(0, 1);
 
         glTexCoord2f(1.0f, 1.0f);
-        glVertex2i(width, height);
+        glVertex2i(1, 1);
 
         glTexCoord2f(1.0f, 0.0f);
-        glVertex2i(width, 0);
+        glVertex2i(1, 0);
 
         glEnd();
 
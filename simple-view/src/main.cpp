@@ -2,9 +2,209 @@
 #include <GLFW/glfw3.h>
 #include <iostream>
 #include <thread>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <memory>
+#include <chrono>
 #include "gl_draw.h"
+#include "gl/capture.hpp"
+#include "gl/readback.hpp"
+#include "gl/scheduler.hpp"
+#include "gl/viewport.hpp"
+#include "gl/pyramid.hpp"
+#include "gl/texture_array.hpp"
 
-int main(void)
+// state shared with the window callbacks
+struct window_state
+{
+    scheduler* sched = nullptr;
+
+    // only set in tiled mode
+    viewport* view = nullptr;
+
+    // set otherwise, pan and zoom re-run its kernel
+    explorer* ex = nullptr;
+
+    // images loaded with --image-dir, page up and down select the one shown
+    texture_array* batch = nullptr;
+    size_t layer = 0;
+
+    bool dragging = false;
+
+    double cursor_x = 0;
+    double cursor_y = 0;
+};
+
+window_state& state_of(GLFWwindow* window)
+{
+    return *static_cast<window_state*>(glfwGetWindowUserPointer(window));
+}
+
+// window coordinates relative to the window size, y upwards
+void window_fraction(GLFWwindow* window, double x, double y, double& fx, double& fy)
+{
+    int width, height;
+    glfwGetWindowSize(window, &width, &height);
+
+    fx = width ? x / width : 0;
+    fy = height ? 1 - y / height : 0;
+}
+
+// framebuffer pixels per window unit, above 1 on high dpi displays
+void framebuffer_scale(GLFWwindow* window, double& sx, double& sy)
+{
+    int width, height, fb_width, fb_height;
+    glfwGetWindowSize(window, &width, &height);
+    glfwGetFramebufferSize(window, &fb_width, &fb_height);
+
+    sx = width ? static_cast<double>(fb_width) / width : 1;
+    sy = height ? static_cast<double>(fb_height) / height : 1;
+}
+
+// every window event may change what is on screen
+void request_frame(GLFWwindow* window)
+{
+    state_of(window).sched->request();
+}
+
+void on_key(GLFWwindow* window, int key, int /*scancode*/, int action, int /*mods*/)
+{
+    auto& state = state_of(window);
+
+    if (state.view && action != GLFW_RELEASE)
+    {
+        auto& view = *state.view;
+
+        const double step_x = view.width / 8.0;
+        const double step_y = view.height / 8.0;
+
+        switch (key)
+        {
+        case GLFW_KEY_LEFT:  view.pan(step_x, 0);  break;
+        case GLFW_KEY_RIGHT: view.pan(-step_x, 0); break;
+        case GLFW_KEY_UP:    view.pan(0, -step_y); break;
+        case GLFW_KEY_DOWN:  view.pan(0, step_y);  break;
+        case GLFW_KEY_EQUAL: view.zoom(1.25, view.width / 2.0, view.height / 2.0); break;
+        case GLFW_KEY_MINUS: view.zoom(0.8, view.width / 2.0, view.height / 2.0);  break;
+        }
+    }
+    else if (state.ex && action != GLFW_RELEASE)
+    {
+        auto& ex = *state.ex;
+
+        const double step_x = ex.width / 8.0;
+        const double step_y = ex.height / 8.0;
+
+        switch (key)
+        {
+        case GLFW_KEY_LEFT:  ex.pan(step_x, 0);  break;
+        case GLFW_KEY_RIGHT: ex.pan(-step_x, 0); break;
+        case GLFW_KEY_UP:    ex.pan(0, -step_y); break;
+        case GLFW_KEY_DOWN:  ex.pan(0, step_y);  break;
+        case GLFW_KEY_EQUAL: ex.zoom(1.25, ex.width / 2.0, ex.height / 2.0); break;
+        case GLFW_KEY_MINUS: ex.zoom(0.8, ex.width / 2.0, ex.height / 2.0);  break;
+        }
+
+        if (state.batch && (key == GLFW_KEY_PAGE_UP || key == GLFW_KEY_PAGE_DOWN))
+        {
+            const size_t count = state.batch->layers.size();
+
+            state.layer = (state.layer + (key == GLFW_KEY_PAGE_UP ? 1 : count - 1)) % count;
+
+            ex.show(state.batch->read(state.layer));
+
+            std::cout << "Layer " << state.layer << ": " << state.batch->layers[state.layer].name << '\n';
+        }
+    }
+
+    request_frame(window);
+}
+
+void on_mouse_button(GLFWwindow* window, int button, int action, int /*mods*/)
+{
+    auto& state = state_of(window);
+
+    if (button == GLFW_MOUSE_BUTTON_LEFT)
+    {
+        state.dragging = action == GLFW_PRESS;
+
+        glfwGetCursorPos(window, &state.cursor_x, &state.cursor_y);
+    }
+
+    request_frame(window);
+}
+
+void on_cursor(GLFWwindow* window, double x, double y)
+{
+    auto& state = state_of(window);
+
+    if (state.view && state.dragging)
+    {
+        // the viewport works in framebuffer pixels,
+        // window y grows downwards, canvas y upwards
+        double sx, sy;
+        framebuffer_scale(window, sx, sy);
+
+        state.view->pan((x - state.cursor_x) * sx, (state.cursor_y - y) * sy);
+
+        request_frame(window);
+    }
+    else if (state.ex && state.dragging)
+    {
+        // the frame is stretched over the window
+        double fx, fy, last_x, last_y;
+        window_fraction(window, x, y, fx, fy);
+        window_fraction(window, state.cursor_x, state.cursor_y, last_x, last_y);
+
+        state.ex->pan((fx - last_x) * state.ex->width, (fy - last_y) * state.ex->height);
+
+        request_frame(window);
+    }
+
+    state.cursor_x = x;
+    state.cursor_y = y;
+}
+
+void on_scroll(GLFWwindow* window, double /*x*/, double y)
+{
+    auto& state = state_of(window);
+
+    if (state.view)
+    {
+        double sx, sy;
+        framebuffer_scale(window, sx, sy);
+
+        state.view->zoom(std::pow(1.1, y), state.cursor_x * sx, state.view->height - state.cursor_y * sy);
+    }
+    else if (state.ex)
+    {
+        double fx, fy;
+        window_fraction(window, state.cursor_x, state.cursor_y, fx, fy);
+
+        state.ex->zoom(std::pow(1.1, y), fx * state.ex->width, fy * state.ex->height);
+    }
+
+    request_frame(window);
+}
+
+void on_resize(GLFWwindow* window, int width, int height)
+{
+    auto& state = state_of(window);
+
+    if (state.view)
+    {
+        state.view->resize(width, height);
+    }
+    else if (state.ex)
+    {
+        state.ex->init(width, height);
+    }
+
+    request_frame(window);
+}
+
+int main(int argc, char* argv[])
 {
     //std::thread server(start_server);
 
@@ -35,26 +235,309 @@ int main(void)
 
             explorer ex;
 
-            ex.init();
+            capture recorder;
+            capture::options capture_options;
+
+            const char* capture_path = nullptr;
+            bool capture_readback = false;
+
+            scheduler sched;
+
+            double max_fps = 0;
+            bool vsync = true;
+
+            bool tiled = false;
+
+            pyramid_reader image;
+
+            const char* image_path = nullptr;
+            const char* image_dir = nullptr;
+
+            for (int i = 1; i < argc; ++i)
+            {
+                if (!std::strcmp(argv[i], "--progressive"))
+                {
+                    ex.progressive = true;
+                }
+                else if (!std::strcmp(argv[i], "--capture") && i + 1 < argc)
+                {
+                    capture_path = argv[++i];
+                }
+                else if (!std::strcmp(argv[i], "--capture-ppm"))
+                {
+                    capture_options.type = capture::format::ppm;
+                }
+                else if (!std::strcmp(argv[i], "--capture-direct"))
+                {
+                    capture_options.direct = true;
+                }
+                else if (!std::strcmp(argv[i], "--capture-readback"))
+                {
+                    capture_readback = true;
+                }
+                else if (!std::strcmp(argv[i], "--fps") && i + 1 < argc)
+                {
+                    max_fps = std::atof(argv[++i]);
+                }
+                else if (!std::strcmp(argv[i], "--no-vsync"))
+                {
+                    vsync = false;
+                }
+                else if (!std::strcmp(argv[i], "--tiled"))
+                {
+                    tiled = true;
+                }
+                else if (!std::strcmp(argv[i], "--image") && i + 1 < argc)
+                {
+                    image_path = argv[++i];
+                }
+                else if (!std::strcmp(argv[i], "--image-dir") && i + 1 < argc)
+                {
+                    image_dir = argv[++i];
+                }
+                else if (!std::strcmp(argv[i], "--pyramid") && i + 1 < argc)
+                {
+                    if (image.open(argv[++i]))
+                    {
+                        tiled = true;
+                    }
+                    else
+                    {
+                        std::cerr << "Unable to open pyramid " << argv[i] << '\n';
+                    }
+                }
+            }
+
+            int fb_width, fb_height;
+            glfwGetFramebufferSize(window, &fb_width, &fb_height);
+
+            ex.init(fb_width, fb_height);
+
+            thread_pool pool;
+            decoder images(pool);
+            texture_array batch;
+
+            if (image_path)
+            {
+                auto img = images.load(image_path);
+
+                if (img)
+                {
+                    if (!ex.show(std::move(img)))
+                    {
+                        std::cerr << image_path << " exceeds the texture size limit\n";
+                    }
+                }
+                else
+                {
+                    std::cerr << "Unable to decode " << image_path << '\n';
+                }
+            }
+
+            if (image_dir)
+            {
+                auto start = std::chrono::steady_clock::now();
+                auto count = batch.load(image_dir, images);
+
+                std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+                std::cout << "Loaded " << count << " images from " << image_dir << " into a " << batch.width << "x" << batch.height
+                          << " texture array in " << elapsed.count() << " ms\n";
+            }
+
+            if (image_path || image_dir)
+            {
+                auto stats = images.statistics();
+
+                std::cout << "Decoded " << stats.files << " files, " << stats.megabytes_per_second() << " MB/s, "
+                          << stats.megapixels_per_second() << " MP/s on " << pool.size() << " threads\n";
+            }
+
+            readback reader;
+
+            if (capture_path)
+            {
+                if (!recorder.start(capture_path, capture_options))
+                {
+                    std::cerr << "Unable to open capture output " << capture_path << '\n';
+                }
+                else if (capture_readback || tiled)
+                {
+                    capture_readback = true;
+
+                    // the whole framebuffer, ex.width and ex.height follow a loaded image
+                    int width, height;
+                    glfwGetFramebufferSize(window, &width, &height);
+
+                    reader.init(width, height);
+                }
+            }
+
+            window_state state;
+
+            state.sched = &sched;
+
+            viewport view;
+            std::unique_ptr<tile_cache> tiles;
+
+            if (tiled && image.is_open())
+            {
+                // only the tiles in view are read from the mapping,
+                // their pages are released once they are copied
+                tiles.reset(new tile_cache(image.tile_size()));
+
+                tiles->set_generator([&image](const tile_key& key, pixel* data, int /*size*/) {
+                    image.copy(key.level, key.x, key.y, data);
+                });
+
+                // the reads of a whole batch are started before the workers copy the first tile
+                tiles->set_prefetcher([&image](const std::vector<tile_key>& keys) {
+                    for (auto& key : keys)
+                    {
+                        image.prefetch(image.tile(key.level, key.x, key.y));
+                    }
+                });
+
+                view.canvas_width = static_cast<double>(image.header().width);
+                view.canvas_height = static_cast<double>(image.header().height);
+                view.max_level = static_cast<int>(image.levels()) - 1;
+            }
+            else if (tiled)
+            {
+                tiles.reset(new tile_cache);
+
+                tiles->set_kernel(kernel::pixels([](int i, int j) { return pixel(i, j, 0); }));
+            }
+
+            if (tiled)
+            {
+                tiles->set_listener([&sched]() { sched.notify(); });
+
+                int width, height;
+                glfwGetFramebufferSize(window, &width, &height);
+
+                view.resize(width, height);
+
+                state.view = &view;
+            }
+            else
+            {
+                state.ex = &ex;
+
+                if (!batch.layers.empty())
+                {
+                    state.batch = &batch;
+
+                    if (!image_path)
+                    {
+                        ex.show(batch.read(0));
+                    }
+                }
+            }
+
+            uint64_t captured = 0;
+
+            auto submit = [&recorder](const pixel* data, int width, int height) {
+                recorder.submit(data, width, height);
+            };
+
+            sched.set_max_fps(max_fps);
+            sched.set_vsync(vsync);
+
+            glfwSetWindowUserPointer(window, &state);
+
+            glfwSetWindowRefreshCallback(window, [](GLFWwindow* window) { request_frame(window); });
+            glfwSetFramebufferSizeCallback(window, on_resize);
+            glfwSetKeyCallback(window, on_key);
+            glfwSetMouseButtonCallback(window, on_mouse_button);
+            glfwSetCursorPosCallback(window, on_cursor);
+            glfwSetScrollCallback(window, on_scroll);
 
             glClearColor(1, 1, 1, 1);
 
-            /* Loop until the user closes the window */
-            while (!glfwWindowShouldClose(window))
+            /* Sleep until a frame is needed, loop until the user closes the window */
+            while (sched.wait(window))
             {
                 /* Render here */
                 glClear(GL_COLOR_BUFFER_BIT);
 
 
-                ex.DrawTexture();
+                if (tiles)
+                {
+                    view.draw(*tiles);
+                }
+                else
+                {
+                    ex.DrawTexture();
+                }
+
+                if (recorder.recording() && (tiles || captured != ex.generation))
+                {
+                    captured = ex.generation;
+
+                    if (capture_readback)
+                    {
+                        // the window has been resized, the frames change size from here on
+                        int width, height;
+                        glfwGetFramebufferSize(window, &width, &height);
+
+                        if (width != reader.width() || height != reader.height())
+                        {
+                            reader.flush(submit);
+                            reader.init(width, height);
+                        }
+
+                        reader.read(submit);
+                    }
+                    else
+                    {
+                        recorder.submit(ex.texture.get(), ex.width, ex.height);
+                    }
+                }
 
 
                 /* Swap front and back buffers */
                 glfwSwapBuffers(window);
 
-                /* Poll for and process events */
-                glfwPollEvents();
+                sched.presented();
+
+                /* Keep drawing while the frame is still being refined */
+                if (tiles ? tiles->has_ready() : ex.refining())
+                {
+                    sched.request();
+                }
+
+                /* Nothing else will be drawn for now, hand over the last frame read */
+                if (reader.pending() && sched.idle())
+                {
+                    reader.flush(submit);
+                }
+            }
+
+            if (tiles)
+            {
+                const auto& stats = tiles->statistics();
+
+                std::cout << "Tiles " << stats.hits << " hits, " << stats.misses << " misses, "
+                          << stats.uploaded << " uploaded, " << stats.evicted << " evicted\n";
+
+                tiles->release();
+                tiles.reset();
             }
+
+            if (recorder.recording())
+            {
+                reader.flush(submit);
+
+                auto stats = recorder.stop();
+
+                std::cout << "Captured " << stats.written << " of " << stats.submitted << " frames, "
+                          << stats.dropped << " dropped, " << stats.failed << " failed, "
+                          << stats.bytes / (1024 * 1024) << " MiB in " << stats.write_ms << " ms\n";
+            }
+
+            reader.release();
+            batch.release();
         }
         else {
             exit_code = -1;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <fstream>
 
 class DirUtil
 {
@@ -12,6 +13,13 @@ public:
 	// for example
 	// getAssetPath("/home/someuser/projects/xxx/build/bin", "assets"); will return /home/someuser/projects/xxx/assets if this directory exists
 	static std::string getAssetPath(std::string baseDir, const std::string& assetDir);
+
+	// same as getAssetPath, but the result is remembered in a file next to the executable
+	// and later runs only check that the remembered directory still exists
+	static std::string getCachedAssetPath(const std::string& exePath, const std::string& assetDir);
+
+private:
+	static bool isDirectory(const std::string& path);
 };
 #if defined(_WIN32)
 #   include <Windows.h>
@@ -87,8 +95,7 @@ std::string DirUtil::getAssetPath(std::string baseDir, const std::string& assetD
 
 		baseDir += assetDir;
 
-		struct stat info;
-		if (stat(baseDir.c_str(), &info) == 0 && (info.st_mode & S_IFDIR))
+		if (isDirectory(baseDir))
 		{
 			break;
 		}
@@ -97,4 +104,36 @@ std::string DirUtil::getAssetPath(std::string baseDir, const std::string& assetD
 	}
 
 	return baseDir;
-}
\ No newline at end of file
+}
+
+std::string DirUtil::getCachedAssetPath(const std::string& exePath, const std::string& assetDir)
+{
+	const std::string cachePath = exePath + "." + assetDir + ".path";
+
+	std::string cached;
+
+	std::ifstream in(cachePath);
+
+	if (std::getline(in, cached) && isDirectory(cached))
+	{
+		return cached;
+	}
+
+	in.close();
+
+	auto assetPath = getAssetPath(exePath, assetDir);
+
+	if (isDirectory(assetPath))
+	{
+		std::ofstream out(cachePath, std::ios::trunc);
+		out << assetPath << '\n';
+	}
+
+	return assetPath;
+}
+
+bool DirUtil::isDirectory(const std::string& path)
+{
+	struct stat info;
+	return stat(path.c_str(), &info) == 0 && (info.st_mode & S_IFDIR);
+}
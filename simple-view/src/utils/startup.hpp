@@ -0,0 +1,238 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <algorithm>
+
+#if defined(_WIN32)
+#   include <Windows.h>
+#else
+#   include <time.h>
+#   include <unistd.h>
+#endif
+
+// timestamps of startup phases shared by the browser and renderer processes
+//
+// every process appends "<time us> <pid> <process> <phase>" lines to the same
+// trace file, time is wall clock so the processes line up. the browser process
+// starts the file over, it is enabled before any child is launched. marks
+// taken before enable() are kept in memory and written once the path is known
+class StartupTrace
+{
+	struct state
+	{
+		std::FILE* file = nullptr;
+		std::string process;
+		std::vector<std::pair<int64_t, std::string>> early;
+	};
+
+	static state& get()
+	{
+		static state s;
+		return s;
+	}
+
+public:
+	// microseconds since the epoch
+	static int64_t now()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+
+	// time the operating system created this process, 0 when unknown
+	static int64_t processStart();
+
+	static void enable(const std::string& path, const std::string& process)
+	{
+		auto& s = get();
+
+		if (s.file)
+		{
+			return;
+		}
+
+		// one run per trace, the children append to what the browser started
+		s.file = std::fopen(path.c_str(), process.empty() ? "w" : "a");
+		s.process = process.empty() ? "browser" : process;
+
+		if (!s.file)
+		{
+			return;
+		}
+
+		if (auto start = processStart())
+		{
+			write(start, "process start");
+		}
+
+		for (auto& mark : s.early)
+		{
+			write(mark.first, mark.second.c_str());
+		}
+
+		s.early.clear();
+	}
+
+	static bool enabled()
+	{
+		return get().file != nullptr;
+	}
+
+	static void mark(const char* phase)
+	{
+		auto& s = get();
+
+		if (s.file)
+		{
+			write(now(), phase);
+		}
+		else if (s.early.size() < 64)
+		{
+			s.early.emplace_back(now(), phase);
+		}
+	}
+
+	// sorts the trace of all processes into one timeline relative to the first mark
+	static bool combine(const std::string& path, const std::string& output)
+	{
+		struct line
+		{
+			int64_t time;
+			std::string pid;
+			std::string process;
+			std::string phase;
+		};
+
+		if (auto* file = get().file)
+		{
+			std::fflush(file);
+		}
+
+		std::ifstream in(path);
+		std::vector<line> lines;
+		std::string text;
+
+		while (std::getline(in, text))
+		{
+			std::istringstream fields(text);
+			line l;
+
+			if (fields >> l.time >> l.pid >> l.process && std::getline(fields >> std::ws, l.phase))
+			{
+				lines.push_back(l);
+			}
+		}
+
+		if (lines.empty())
+		{
+			return false;
+		}
+
+		std::stable_sort(lines.begin(), lines.end(), [](const line& a, const line& b) { return a.time < b.time; });
+
+		std::FILE* out = std::fopen(output.c_str(), "w");
+
+		if (!out)
+		{
+			return false;
+		}
+
+		std::fprintf(out, "%10s %10s %8s  %-10s %s\n", "time ms", "delta ms", "pid", "process", "phase");
+
+		int64_t previous = lines.front().time;
+
+		for (auto& l : lines)
+		{
+			std::fprintf(out, "%10.3f %10.3f %8s  %-10s %s\n", (l.time - lines.front().time) / 1000.0, (l.time - previous) / 1000.0, l.pid.c_str(), l.process.c_str(), l.phase.c_str());
+
+			previous = l.time;
+		}
+
+		std::fclose(out);
+
+		return true;
+	}
+
+private:
+	static void write(int64_t time, const char* phase)
+	{
+		auto& s = get();
+
+#if defined(_WIN32)
+		unsigned long pid = GetCurrentProcessId();
+#else
+		unsigned long pid = static_cast<unsigned long>(getpid());
+#endif
+
+		std::fprintf(s.file, "%lld %lu %s %s\n", static_cast<long long>(time), pid, s.process.c_str(), phase);
+		std::fflush(s.file);
+	}
+};
+
+int64_t StartupTrace::processStart()
+{
+#if defined(_WIN32)
+	FILETIME creation, exit, kernel, user;
+
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+	{
+		return 0;
+	}
+
+	ULARGE_INTEGER ticks;
+	ticks.LowPart = creation.dwLowDateTime;
+	ticks.HighPart = creation.dwHighDateTime;
+
+	// 100 ns ticks since 1601
+	return static_cast<int64_t>(ticks.QuadPart / 10) - 11644473600000000LL;
+#elif defined(__linux__)
+	// start time in clock ticks since boot
+	std::ifstream stat("/proc/self/stat");
+	std::string content((std::istreambuf_iterator<char>(stat)), std::istreambuf_iterator<char>());
+
+	auto close = content.rfind(')');
+
+	if (close == std::string::npos)
+	{
+		return 0;
+	}
+
+	std::istringstream fields(content.substr(close + 2));
+	std::string field;
+
+	// state is field 3, starttime field 22
+	for (int i = 3; i < 22 && fields >> field; ++i)
+	{;}
+
+	long long start = 0;
+
+	if (!(fields >> start))
+	{
+		return 0;
+	}
+
+	const long hz = sysconf(_SC_CLK_TCK);
+
+	// the boot time in /proc/stat is whole seconds, the age of the process
+	// on the boot clock (which counts suspend like starttime) is exact
+	timespec realtime, boottime;
+
+	if (hz <= 0 || clock_gettime(CLOCK_REALTIME, &realtime) != 0 || clock_gettime(CLOCK_BOOTTIME, &boottime) != 0)
+	{
+		return 0;
+	}
+
+	const long long uptime = boottime.tv_sec * 1000000LL + boottime.tv_nsec / 1000;
+	const long long age = uptime - start * 1000000LL / hz;
+
+	return realtime.tv_sec * 1000000LL + realtime.tv_nsec / 1000 - age;
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,268 @@
+// converts an uncompressed bmp, ppm/pgm or tga image into a tiled pyramid
+// (see src/gl/pyramid.hpp)
+//
+// usage: pyramid-convert <input> <output> [--tile size]
+//        pyramid-convert --synthetic <width> <height> <output> [--tile size]
+//
+// the input is read in bands of rows, so images larger than memory work
+
+#include "../src/gl/pyramid.hpp"
+#include "../src/gl/image_format.hpp"
+
+#include <chrono>
+#include <memory>
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+    bool seek(std::FILE* file, uint64_t offset)
+    {
+#if defined(_WIN32)
+        return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+        return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+    }
+
+    // rows of an uncompressed image file, numbered from the bottom
+    class row_source
+    {
+    public:
+        uint64_t width = 0;
+        uint64_t height = 0;
+
+        virtual ~row_source() {}
+
+        virtual bool read(uint64_t row, pixel* out) = 0;
+    };
+
+    // the header is parsed by image_layout like in the decoder,
+    // the rows are read from the file a chunk at a time
+    class file_rows : public row_source
+    {
+        static constexpr size_t chunk_bytes = 16 << 20;
+
+        std::FILE* __file = nullptr;
+
+        // start of the file, the layout points into it (e.g. the bmp palette)
+        std::vector<uint8_t> __header;
+        image_layout __layout;
+
+        uint64_t __data = 0;
+        uint64_t __stride = 0;
+
+        std::vector<uint8_t> __chunk;
+        uint64_t __chunk_first = 0;
+        uint64_t __chunk_rows = 0;
+
+        // file row in the chunk, loading the chunk that holds it when needed
+        const uint8_t* row_data(uint64_t row)
+        {
+            const uint64_t stored = __layout.top_down ? height - 1 - row : row;
+
+            if (stored < __chunk_first || stored >= __chunk_first + __chunk_rows)
+            {
+                const uint64_t per_chunk = std::max<uint64_t>(1, chunk_bytes / __stride);
+
+                __chunk_first = stored / per_chunk * per_chunk;
+                __chunk_rows = std::min(per_chunk, height - __chunk_first);
+
+                __chunk.resize(static_cast<size_t>(__chunk_rows * __stride));
+
+                if (!seek(__file, __data + __chunk_first * __stride) || std::fread(__chunk.data(), 1, __chunk.size(), __file) != __chunk.size())
+                {
+                    __chunk_rows = 0;
+                    return nullptr;
+                }
+            }
+
+            return __chunk.data() + (stored - __chunk_first) * __stride;
+        }
+
+    public:
+        ~file_rows()
+        {
+            if (__file)
+            {
+                std::fclose(__file);
+            }
+        }
+
+        bool open(const std::string& path)
+        {
+            __file = std::fopen(path.c_str(), "rb");
+
+            if (!__file || std::fseek(__file, 0, SEEK_END) != 0)
+            {
+                return false;
+            }
+
+#if defined(_WIN32)
+            const int64_t total = _ftelli64(__file);
+#else
+            const int64_t total = ftello(__file);
+#endif
+
+            if (total <= 0 || !seek(__file, 0))
+            {
+                return false;
+            }
+
+            __header.resize(static_cast<size_t>(std::min<int64_t>(total, image_layout::header_bytes)));
+
+            if (std::fread(__header.data(), 1, __header.size(), __file) != __header.size())
+            {
+                return false;
+            }
+
+            __layout = image_layout::probe(__header.data(), __header.size(), static_cast<size_t>(total));
+
+            // run length encoded rows cannot be located without reading the file
+            if (__layout.type == image_format::none || __layout.rle)
+            {
+                return false;
+            }
+
+            width = static_cast<uint64_t>(__layout.width);
+            height = static_cast<uint64_t>(__layout.height);
+
+            __data = static_cast<uint64_t>(__layout.data - __header.data());
+            __stride = __layout.stride;
+
+            return true;
+        }
+
+        bool read(uint64_t row, pixel* out) override
+        {
+            const uint8_t* p = row_data(row);
+
+            if (!p)
+            {
+                return false;
+            }
+
+            image_layout::convert(__layout, p, out, __layout.width);
+
+            return true;
+        }
+    };
+
+    // generated test pattern for images of any size
+    class synthetic_rows : public row_source
+    {
+    public:
+        synthetic_rows(uint64_t w, uint64_t h)
+        {
+            width = w;
+            height = h;
+        }
+
+        bool read(uint64_t row, pixel* out) override
+        {
+            for (uint64_t j = 0; j < width; ++j)
+            {
+                out[j] = pixel(static_cast<uint8_t>(row), static_cast<uint8_t>(j), static_cast<uint8_t>((row ^ j) >> 8));
+            }
+
+            return true;
+        }
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    uint32_t tile = 256;
+
+    for (size_t i = 0; i + 1 < args.size(); ++i)
+    {
+        if (args[i] == "--tile")
+        {
+            tile = static_cast<uint32_t>(std::atoi(args[i + 1].c_str()));
+            args.erase(args.begin() + i, args.begin() + i + 2);
+            break;
+        }
+    }
+
+    if (!pyramid_layout::valid_tile_size(tile))
+    {
+        // tiles have to be whole pages to be mapped and released on their own
+        const uint32_t g = pyramid_layout::tile_granularity;
+        const uint32_t rounded = tile ? (tile + g - 1) / g * g : 256;
+
+        std::cerr << "Tile size " << tile << " is not a multiple of " << g << ", using " << rounded << '\n';
+
+        tile = rounded;
+    }
+
+    std::unique_ptr<row_source> source;
+    std::string output;
+
+    if (args.size() == 4 && args[0] == "--synthetic")
+    {
+        source.reset(new synthetic_rows(std::strtoull(args[1].c_str(), nullptr, 10), std::strtoull(args[2].c_str(), nullptr, 10)));
+        output = args[3];
+    }
+    else if (args.size() == 2)
+    {
+        output = args[1];
+
+        auto file = new file_rows;
+        source.reset(file);
+
+        if (!file->open(args[0]))
+        {
+            source.reset();
+        }
+
+        if (!source)
+        {
+            std::cerr << "Unsupported or unreadable input " << args[0] << '\n';
+            return 1;
+        }
+    }
+    else
+    {
+        std::cerr << "usage: pyramid-convert <input.bmp|ppm|pgm|tga> <output> [--tile size]\n"
+                  << "       pyramid-convert --synthetic <width> <height> <output> [--tile size]\n";
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    pyramid_writer writer;
+
+    if (!writer.open(output, source->width, source->height, tile))
+    {
+        std::cerr << "Unable to create " << output << '\n';
+        return 1;
+    }
+
+    std::vector<pixel> row(static_cast<size_t>(source->width));
+
+    for (uint64_t i = 0; i < source->height; ++i)
+    {
+        if (!source->read(i, row.data()) || !writer.push(row.data()))
+        {
+            std::cerr << "Conversion failed at row " << i << '\n';
+            return 1;
+        }
+    }
+
+    if (!writer.close())
+    {
+        std::cerr << "Unable to finish " << output << '\n';
+        return 1;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    const double megapixels = static_cast<double>(source->width) * source->height / 1e6;
+
+    std::cout << source->width << "x" << source->height << " -> " << output << " in " << elapsed.count() << " s ("
+              << megapixels / elapsed.count() << " MP/s)\n";
+
+    return 0;
+}
@@ -0,0 +1,235 @@
+// cold start comparison of the cef-async startup switches (see src/cef/browser.hpp)
+//
+// usage: startup-compare <cef-async> [--runs n] [--views n] [--set "<switches>"]...
+//
+// starts cef-async n times per switch set with --startup-trace, lets it close
+// itself after the first load and summarizes the phases of the .timeline
+// files: median, min and max time of the first occurrence of every phase per
+// process type, and the number of renderer processes, which exceeds the
+// number of views when a spare renderer was started. without --set the
+// switches are compared one by one and all together. the page cache is
+// dropped before every run where the system allows it (linux, as root),
+// otherwise the runs after the first are warm starts
+
+#include <map>
+#include <set>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+#if defined(__linux__)
+#   include <unistd.h>
+#endif
+
+namespace
+{
+    struct run
+    {
+        // first time of "<process> <phase>" in ms since the first mark
+        std::map<std::string, double> phases;
+
+        size_t renderers = 0;
+    };
+
+    bool drop_caches()
+    {
+#if defined(__linux__)
+        if (geteuid() != 0)
+        {
+            return false;
+        }
+
+        sync();
+
+        std::ofstream control("/proc/sys/vm/drop_caches");
+
+        return static_cast<bool>(control << "3\n");
+#else
+        return false;
+#endif
+    }
+
+    bool read_timeline(const std::string& path, run& result)
+    {
+        std::ifstream in(path);
+        std::string text;
+
+        // header
+        if (!std::getline(in, text))
+        {
+            return false;
+        }
+
+        std::set<std::string> renderers;
+
+        while (std::getline(in, text))
+        {
+            std::istringstream fields(text);
+
+            double time, delta;
+            std::string pid, process, phase;
+
+            if (!(fields >> time >> delta >> pid >> process) || !std::getline(fields >> std::ws, phase))
+            {
+                continue;
+            }
+
+            result.phases.emplace(process + " " + phase, time);
+
+            if (process == "renderer")
+            {
+                renderers.insert(pid);
+            }
+        }
+
+        result.renderers = renderers.size();
+
+        return !result.phases.empty();
+    }
+
+    double median(std::vector<double> values)
+    {
+        std::sort(values.begin(), values.end());
+
+        const size_t n = values.size();
+
+        return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+    }
+
+    void summarize(const std::string& switches, const std::vector<run>& runs)
+    {
+        std::cout << "\n[" << (switches.empty() ? "no switches" : switches) << "] " << runs.size() << " runs\n";
+
+        if (runs.empty())
+        {
+            return;
+        }
+
+        std::map<std::string, std::vector<double>> times;
+
+        for (auto& r : runs)
+        {
+            for (auto& phase : r.phases)
+            {
+                times[phase.first].push_back(phase.second);
+            }
+        }
+
+        // phases in the order they happen
+        std::vector<std::pair<double, std::string>> order;
+
+        for (auto& t : times)
+        {
+            order.emplace_back(median(t.second), t.first);
+        }
+
+        std::sort(order.begin(), order.end());
+
+        std::printf("%10s %10s %10s %5s  %s\n", "median ms", "min ms", "max ms", "runs", "phase");
+
+        for (auto& o : order)
+        {
+            auto& values = times[o.second];
+
+            std::printf("%10.1f %10.1f %10.1f %5zu  %s\n", o.first, *std::min_element(values.begin(), values.end()), *std::max_element(values.begin(), values.end()), values.size(), o.second.c_str());
+        }
+
+        std::vector<double> renderers;
+
+        for (auto& r : runs)
+        {
+            renderers.push_back(static_cast<double>(r.renderers));
+        }
+
+        std::printf("renderer processes, median %.1f\n", median(renderers));
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: startup-compare <cef-async> [--runs n] [--views n] [--set \"<switches>\"]...\n";
+        return 1;
+    }
+
+    const std::string program = argv[1];
+
+    int runs = 5;
+    int views = 1;
+
+    std::vector<std::string> sets;
+
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        const std::string option = argv[i];
+
+        if (option == "--runs")
+        {
+            runs = std::max(1, std::atoi(argv[i + 1]));
+        }
+        else if (option == "--views")
+        {
+            views = std::max(1, std::atoi(argv[i + 1]));
+        }
+        else if (option == "--set")
+        {
+            sets.push_back(argv[i + 1]);
+        }
+    }
+
+    if (sets.empty())
+    {
+        sets = { "", "--prewarm-renderer", "--defer-callbacks", "--cache-asset-path", "--prewarm-renderer --defer-callbacks --cache-asset-path" };
+    }
+
+    const std::string trace = "startup-compare.trace";
+    const std::string timeline = trace + ".timeline";
+
+    bool cold = true;
+
+    std::vector<std::vector<run>> results(sets.size());
+
+    // interleaved, so a drift of the machine affects every set alike
+    for (int n = 0; n < runs; ++n)
+    {
+        for (size_t k = 0; k < sets.size(); ++k)
+        {
+            std::remove(trace.c_str());
+            std::remove(timeline.c_str());
+
+            cold = drop_caches() && cold;
+
+            const std::string command = "\"" + program + "\" " + sets[k] + " --startup-trace=" + trace + " --exit-after-load=500 --views=" + std::to_string(views);
+
+            if (std::system(command.c_str()) != 0)
+            {
+                std::cerr << "run " << n << " of [" << sets[k] << "] failed\n";
+            }
+
+            run r;
+
+            if (read_timeline(timeline, r))
+            {
+                results[k].push_back(r);
+            }
+        }
+    }
+
+    if (!cold)
+    {
+        std::cout << "the page cache could not be dropped, only the first run of the first set is a cold start\n";
+    }
+
+    for (size_t k = 0; k < sets.size(); ++k)
+    {
+        summarize(sets[k], results[k]);
+    }
+
+    return 0;
+}